@@ -1,32 +1,51 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
 #include <format>
+#include <fstream>
 #include <generator>
 #include <iostream>
 #include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <numeric>
-#include <set>
+#include <optional>
+#include <random>
+#include <shared_mutex>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
-using namespace std;
+#include "../common/boundary.h"
+#include "../common/certificate_cache.h"
+#include "../common/frontier.h"
+#include "../common/packed_antichain.h"
+#include "../common/search_stats.h"
+#include "../common/size_sequences.h"
 
-struct MatchingState {
-  vector<char> used_x;
-  vector<char> used_y;
+using namespace std;
 
-  explicit MatchingState(int s) : used_x(s + 1), used_y(s + 1) {}
-
-  void reset() {
-    ranges::fill(used_x, 0);
-    ranges::fill(used_y, 0);
-  }
-};
+using Corner = pair<uint8_t, uint8_t>;
+using GraphId = uint16_t;
 
 struct ShiftedGraph {
-  int s;
-  vector<pair<int, int>> antipath;
+  span<const Corner> antipath;
 
   generator<const pair<int, int> &> edges() const {
     int x = 1;
@@ -38,80 +57,584 @@ struct ShiftedGraph {
       }
     }
   }
+
+  bool has_edge(int x, int y) const {
+    for (auto [x0, y0] : antipath) {
+      if (x <= x0) {
+        return 1 <= x && 1 <= y && y <= y0;
+      }
+    }
+    return false;
+  }
 };
 
-generator<ShiftedGraph &&> gen_graphs(int s, int current_x, int max_y) {
+generator<vector<Corner> &&> gen_graphs(int s, int current_x, int max_y) {
   // cerr << "Generating graph " << s << " " << edge_budget << " " << current_x
   // << " " << max_y << "\n";
   if (current_x > s || max_y <= 0) {
-    co_yield ShiftedGraph{s, {}};
+    co_yield {};
   } else {
     for (int x = current_x; x <= s; ++x) {
       for (int y = (x == s ? 0 : 1); y <= max_y; ++y) {
-        for (auto &&graph : gen_graphs(s, x + 1, y - 1)) {
-          graph.antipath.emplace_back(x, y);
-          co_yield std::move(graph);
+        for (auto &&antipath : gen_graphs(s, x + 1, y - 1)) {
+          antipath.emplace_back(x, y);
+          co_yield std::move(antipath);
         }
       }
     }
   }
 }
 
-bool gen_matching(input_iterator auto graphs_begin,
-                  input_iterator auto graphs_end, MatchingState &state) {
-  if (graphs_begin == graphs_end) {
+constexpr int kMaxColours = 16;
+
+// All shifted graphs of one s in a single arena, grouped by edge count. A
+// graph is addressed by a 16-bit id: the graphs with `size` edges are the ids
+// [bucket_begin[size], bucket_begin[size + 1]), the antipath of graph `id` is
+// corners[corner_begin[id], corner_begin[id + 1]).
+//
+// Swapping the sides maps a graph to its transpose, which has the same edge
+// count, and a graph sequence to one with the same matchings. Every bucket
+// lists first the graphs that do not come after their transpose in
+// generation order, up to canonical_end[size].
+struct GraphCatalogue {
+  int s;
+  vector<GraphId> bucket_begin;
+  vector<GraphId> canonical_end;
+  vector<uint32_t> corner_begin;
+  vector<Corner> corners;
+
+  // caps[x] is the largest neighbour of x, 0 if there is none.
+  static vector<int> caps_of(int s, span<const Corner> antipath) {
+    vector<int> caps(s + 1);
+    int x = 1;
+    for (auto [x0, y0] : antipath) {
+      for (; x <= x0; ++x) {
+        caps[x] = y0;
+      }
+    }
+    return caps;
+  }
+
+  static vector<int> transposed(const vector<int> &caps) {
+    vector<int> res(caps.size());
+    for (int y = 1; y < caps.size(); ++y) {
+      res[y] = ranges::count_if(caps, [y](int cap) { return cap >= y; });
+    }
+    return res;
+  }
+
+  explicit GraphCatalogue(int s) : s(s) {
+    if (s > kMaxColours) {
+      throw runtime_error("s is larger than kMaxColours");
+    }
+    vector<vector<vector<Corner>>> antipaths_by_size(s * s + 1);
+    for (auto &&antipath : gen_graphs(s, 1, s)) {
+      ranges::reverse(antipath);
+      auto edges = ShiftedGraph{antipath}.edges();
+      int size = ranges::distance(edges.begin(), edges.end());
+      antipaths_by_size[size].push_back(move(antipath));
+    }
+    bucket_begin.push_back(0);
+    corner_begin.push_back(0);
+    for (auto &bucket : antipaths_by_size) {
+      map<vector<int>, int> index;
+      for (const auto &[i, antipath] : bucket | views::enumerate) {
+        index.emplace(caps_of(s, antipath), i);
+      }
+      vector<vector<Corner>> ordered, rest;
+      for (auto &&[i, antipath] : bucket | views::enumerate) {
+        if (i <= index.at(transposed(caps_of(s, antipath)))) {
+          ordered.push_back(move(antipath));
+        } else {
+          rest.push_back(move(antipath));
+        }
+      }
+      int canonical = ordered.size();
+      ranges::move(rest, back_inserter(ordered));
+      bucket = move(ordered);
+      for (const auto &antipath : bucket) {
+        corners.insert(corners.end(), antipath.begin(), antipath.end());
+        corner_begin.push_back(corners.size());
+      }
+      if (corner_begin.size() - 1 > numeric_limits<GraphId>::max()) {
+        throw runtime_error("too many shifted graphs for 16-bit ids");
+      }
+      canonical_end.push_back(bucket_begin.back() + canonical);
+      bucket_begin.push_back(corner_begin.size() - 1);
+    }
+  }
+
+  int max_size() const { return bucket_begin.size() - 2; }
+
+  int bucket_size(int size) const {
+    return bucket_begin[size + 1] - bucket_begin[size];
+  }
+
+  int canonical_size(int size) const {
+    return canonical_end[size] - bucket_begin[size];
+  }
+
+  auto bucket(int size) const {
+    return views::iota(bucket_begin[size], bucket_begin[size + 1]);
+  }
+
+  // The edge count of graph `id`.
+  int size_of(GraphId id) const {
+    return ranges::upper_bound(bucket_begin, id) - bucket_begin.begin() - 1;
+  }
+
+  ShiftedGraph operator[](GraphId id) const {
+    return {span(corners).subspan(corner_begin[id],
+                                  corner_begin[id + 1] - corner_begin[id])};
+  }
+};
+
+// The graphs of a graph sequence, one id per colour, stored inline.
+struct GraphSequence {
+  array<GraphId, kMaxColours> ids;
+  int length = 0;
+
+  const GraphId *begin() const { return ids.data(); }
+  const GraphId *end() const { return ids.data() + length; }
+  int size() const { return length; }
+  bool empty() const { return length == 0; }
+  GraphId operator[](int i) const { return ids[i]; }
+  GraphId &operator[](int i) { return ids[i]; }
+  GraphId front() const { return ids[0]; }
+  GraphId back() const { return ids[length - 1]; }
+  void push_back(GraphId id) { ids[length++] = id; }
+  void pop_back() { --length; }
+};
+
+// Interchangeable algorithms for a rainbow matching of one graph sequence,
+// see find_matching.
+enum MatchingBackend {
+  kDfsBackend,
+  kSubsetDpBackend,
+  kCoverBackend,
+  kGreedyBackend,
+  kBackendCount
+};
+
+constexpr array<const char *, kBackendCount> backend_names = {
+    "dfs", "dp", "cover", "greedy+dfs"};
+
+// Graph sequences fall into kRegimes regimes by edge density: their edges over
+// the most s graphs can have, in kRegimes equal ranges. Every regime has a
+// backend of its own.
+constexpr int kRegimes = 4;
+using BackendChoice = array<MatchingBackend, kRegimes>;
+
+struct MatchingState {
+  // A nogood learned by gen_matching: colours i.. with the graphs `suffix`
+  // have no rainbow matching avoiding any of the vertex sets `masks` (x is
+  // bit x - 1, y is bit s + y - 1). It holds for every graph sequence with
+  // that suffix.
+  struct Nogood {
+    GraphSequence suffix;
+    vector<uint32_t> masks;
+  };
+  static constexpr int kMaxNogoods = 1 << 16;
+  static constexpr int kMaxNogoodMasks = 8;
+
+  const GraphCatalogue &catalogue;
+  int s;
+  vector<char> used_x;
+  vector<char> used_y;
+  // owner_x[x], owner_y[y] are the colours matched to x and y, -1 if free.
+  vector<int8_t> owner_x;
+  vector<int8_t> owner_y;
+  uint32_t used_vertices = 0;
+  vector<pair<int, int>> matching;
+  uint64_t nodes = 0;
+  // gen_matching gives up (returns false) once nodes exceeds this.
+  uint64_t node_limit = numeric_limits<uint64_t>::max();
+  // Keyed by a hash of the suffix, kept across graph sequences.
+  unordered_map<uint64_t, Nogood> nogoods;
+  array<uint64_t, kMaxColours + 1> suffix_hash;
+  // The backend find_matching takes for each regime, and scratch space of
+  // the other backends.
+  BackendChoice backends{};
+  vector<vector<uint32_t>> edges_by_colour;
+  vector<vector<uint32_t>> layers;
+
+  explicit MatchingState(const GraphCatalogue &catalogue)
+      : catalogue(catalogue), s(catalogue.s), used_x(s + 1), used_y(s + 1),
+        owner_x(s + 1, -1), owner_y(s + 1, -1) {}
+
+  void reset() {
+    ranges::fill(used_x, 0);
+    ranges::fill(used_y, 0);
+    ranges::fill(owner_x, -1);
+    ranges::fill(owner_y, -1);
+    used_vertices = 0;
+    matching.clear();
+  }
+
+  uint32_t edge_bits(int x, int y) const {
+    return 1u << (x - 1) | 1u << (s + y - 1);
+  }
+
+  // The edges of a graph as vertex masks, in the order of edges().
+  void edge_masks(GraphId graph, vector<uint32_t> &res) const {
+    res.clear();
+    int x = 1;
+    for (auto [x0, y0] : catalogue[graph].antipath) {
+      for (; x <= x0; ++x) {
+        for (int y = 1; y <= y0; ++y) {
+          res.push_back(edge_bits(x, y));
+        }
+      }
+    }
+  }
+
+  // The edge (x, y) of a mask from edge_masks.
+  pair<int, int> edge_of(uint32_t mask) const {
+    return {countr_zero(mask) + 1, bit_width(mask) - s};
+  }
+
+  int regime(const GraphSequence &graph_sequence) const {
+    int edges = 0;
+    for (GraphId graph : graph_sequence) {
+      edges += catalogue.size_of(graph);
+    }
+    return edges * kRegimes /
+           (graph_sequence.size() * catalogue.max_size() + 1);
+  }
+
+  void take(int colour, int x, int y) {
+    used_x[x] = used_y[y] = true;
+    owner_x[x] = owner_y[y] = colour;
+    used_vertices |= edge_bits(x, y);
+    matching.emplace_back(x, y);
+  }
+
+  void release(int x, int y) {
+    used_x[x] = used_y[y] = false;
+    owner_x[x] = owner_y[y] = -1;
+    used_vertices &= ~edge_bits(x, y);
+    matching.pop_back();
+  }
+
+  // The colours matched to the vertices of mask.
+  uint32_t owners(uint32_t mask) const {
+    uint32_t res = 0;
+    for (; mask; mask &= mask - 1) {
+      int bit = countr_zero(mask);
+      res |= 1u << (bit < s ? owner_x[bit + 1] : owner_y[bit - s + 1]);
+    }
+    return res;
+  }
+
+  Nogood *find_nogood(span<const GraphId> suffix, int colour) {
+    auto it = nogoods.find(suffix_hash[colour]);
+    if (it == nogoods.end() || !ranges::equal(it->second.suffix, suffix)) {
+      return nullptr;
+    }
+    return &it->second;
+  }
+
+  // Colours `suffix` (starting at `colour`) failed given the edges of the
+  // colours in `conflict`.
+  void learn(span<const GraphId> suffix, int colour, uint32_t conflict) {
+    uint32_t mask = 0;
+    for (; conflict; conflict &= conflict - 1) {
+      auto [x, y] = matching[countr_zero(conflict)];
+      mask |= edge_bits(x, y);
+    }
+    if (nogoods.size() >= kMaxNogoods) {
+      nogoods.clear();
+    }
+    auto &nogood = nogoods[suffix_hash[colour]];
+    if (!ranges::equal(nogood.suffix, suffix)) {
+      nogood.suffix = {};
+      for (GraphId graph : suffix) {
+        nogood.suffix.push_back(graph);
+      }
+      nogood.masks.clear();
+    }
+    if (ranges::any_of(nogood.masks,
+                       [mask](uint32_t m) { return (m & mask) == m; })) {
+      return;
+    }
+    erase_if(nogood.masks, [mask](uint32_t m) { return (m & mask) == mask; });
+    if (nogood.masks.size() == kMaxNogoodMasks) {
+      nogood.masks.erase(nogood.masks.begin());
+    }
+    nogood.masks.push_back(mask);
+  }
+};
+
+// Matches colours `colour`.. of graphs[0, colours) given the edges already
+// taken. On failure `conflict` is the set of earlier colours whose edges
+// caused it: a colour the failure below it does not depend on is not
+// retried, the search jumps back to the latest colour that matters.
+bool match_colours(const GraphId *graphs, int colour, int colours,
+                   MatchingState &state, uint32_t &conflict) {
+  if (++state.nodes > state.node_limit) {
+    return false;
+  }
+  if (colour == colours) {
     return true;
   }
+  span<const GraphId> suffix(graphs + colour, graphs + colours);
+  if (auto *nogood = state.find_nogood(suffix, colour)) {
+    for (uint32_t mask : nogood->masks) {
+      if ((mask & state.used_vertices) == mask) {
+        conflict = state.owners(mask);
+        return false;
+      }
+    }
+  }
+  uint32_t conf = 0;
   int x = 1;
-  for (auto [x0, y0] : (graphs_begin++)->get().antipath) {
+  for (auto [x0, y0] : state.catalogue[graphs[colour]].antipath) {
     for (; x <= x0; ++x) {
       if (state.used_x[x]) {
+        if (y0 > 0) {
+          conf |= 1u << state.owner_x[x];
+        }
         continue;
       }
       for (int y = 1; y <= y0; ++y) {
         if (state.used_y[y]) {
+          conf |= 1u << state.owner_y[y];
           continue;
         }
-        state.used_x[x] = true;
-        state.used_y[y] = true;
+        state.take(colour, x, y);
         // cerr << format("taking ({}, {})\n", x, y);
-        if (gen_matching(graphs_begin, graphs_end, state)) {
+        uint32_t sub = 0;
+        if (match_colours(graphs, colour + 1, colours, state, sub)) {
           return true;
         }
+        if (state.nodes > state.node_limit) {
+          return false;
+        }
         // cerr << format("removing ({}, {})\n", x, y);
-        state.used_x[x] = false;
-        state.used_y[y] = false;
+        state.release(x, y);
+        if (!(sub >> colour & 1)) {
+          conflict = sub;
+          return false;
+        }
+        conf |= sub & ~(1u << colour);
       }
     }
   }
+  state.learn(suffix, colour, conf);
+  conflict = conf;
   return false;
 }
 
-generator<vector<int> &&> gen_size_sequence(int s, int leftover, int min_size) {
-  if (leftover <= 0) {
-    co_yield {};
-  } else {
-    for (int size = min_size; size <= s * s; ++size) {
-      for (auto &&sequence : gen_size_sequence(s, leftover - 1, size)) {
-        sequence.push_back(size);
-        co_yield sequence;
-        sequence.pop_back();
+// A rainbow matching of the graph sequence from a reset state, by DFS with
+// conflict-directed backjumping and the nogoods the state has learned so far.
+// It decides single graph sequences: those of --check and --sample, and the
+// witnesses a search looks up for its failing rows. The search itself decides
+// whole buckets with sweep_fails and never gets here, so nogoods do not speed
+// it up.
+bool gen_matching(const GraphId *graphs_begin, const GraphId *graphs_end,
+                  MatchingState &state) {
+  int colours = graphs_end - graphs_begin;
+  state.suffix_hash[colours] = 14695981039346656037ull;
+  for (int i = colours - 1; i >= 0; --i) {
+    state.suffix_hash[i] =
+        (state.suffix_hash[i + 1] ^ graphs_begin[i]) * 1099511628211ull;
+  }
+  uint32_t conflict = 0;
+  return match_colours(graphs_begin, 0, colours, state, conflict);
+}
+
+// A heuristic for a rainbow matching, not a decision procedure. In polynomial
+// time, relying on shiftedness, the colour with the fewest free edges goes next
+// and takes its free edge furthest from (1, 1) (largest x + y, then largest
+// max(x, y)), leaving the low vertices all shifted graphs share to the others.
+// It misses matchings that exist, 19 of the 1540 multisets of 3 graphs (see
+// --validate), so a failure proves nothing and only a success is conclusive.
+// On success state.matching holds one edge per colour in graph_sequence order.
+bool greedy_heuristic(const GraphSequence &graph_sequence,
+                      MatchingState &state) {
+  state.reset();
+  int colours = graph_sequence.size();
+  uint32_t used = 0;
+  uint32_t pending = (1u << colours) - 1;
+  auto free_edges = [&](GraphId graph, auto &&visit) {
+    int x = 1;
+    for (auto [x0, y0] : state.catalogue[graph].antipath) {
+      for (; x <= x0; ++x) {
+        if (used >> (x - 1) & 1) {
+          continue;
+        }
+        for (int y = 1; y <= y0; ++y) {
+          if (!(used & state.edge_bits(x, y))) {
+            visit(x, y);
+          }
+        }
+      }
+    }
+  };
+  state.matching.resize(colours);
+  while (pending) {
+    int colour = 0;
+    int fewest = numeric_limits<int>::max();
+    for (uint32_t rest = pending; rest; rest &= rest - 1) {
+      int count = 0;
+      free_edges(graph_sequence[countr_zero(rest)],
+                 [&count](int, int) { ++count; });
+      if (count < fewest) {
+        fewest = count;
+        colour = countr_zero(rest);
       }
     }
+    if (fewest == 0) {
+      state.matching.clear();
+      return false;
+    }
+    pair<int, int> best{0, 0};
+    free_edges(graph_sequence[colour], [&best](int x, int y) {
+      auto [bx, by] = best;
+      if (pair(x + y, max(x, y)) > pair(bx + by, max(bx, by))) {
+        best = {x, y};
+      }
+    });
+    used |= state.edge_bits(best.first, best.second);
+    state.matching[colour] = best;
+    pending &= ~(1u << colour);
   }
+  return true;
 }
 
-generator<vector<reference_wrapper<const ShiftedGraph>>>
+// A rainbow matching by dynamic programming over vertex sets: layers[k + 1]
+// holds, sorted, the vertex sets that matchings of colours 0..k cover, and a
+// matching is traced back from the last layer.
+bool dp_matching(const GraphSequence &graph_sequence, MatchingState &state) {
+  int colours = graph_sequence.size();
+  state.edges_by_colour.resize(colours);
+  state.layers.resize(colours + 1);
+  state.layers[0] = {0};
+  for (int k = 0; k < colours; ++k) {
+    auto &edges = state.edges_by_colour[k];
+    state.edge_masks(graph_sequence[k], edges);
+    auto &next = state.layers[k + 1];
+    next.clear();
+    for (uint32_t used : state.layers[k]) {
+      for (uint32_t edge : edges) {
+        if (!(used & edge)) {
+          next.push_back(used | edge);
+        }
+      }
+    }
+    ranges::sort(next);
+    next.erase(ranges::unique(next).begin(), next.end());
+    state.nodes += next.size();
+    if (next.empty()) {
+      return false;
+    }
+  }
+  state.matching.resize(colours);
+  uint32_t used = state.layers[colours][0];
+  for (int k = colours - 1; k >= 0; --k) {
+    for (uint32_t edge : state.edges_by_colour[k]) {
+      if ((used & edge) == edge &&
+          ranges::binary_search(state.layers[k], used ^ edge)) {
+        state.matching[k] = state.edge_of(edge);
+        used ^= edge;
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+// A rainbow matching as an exact cover of the colours by disjoint edges,
+// searched like Knuth's Algorithm X: the colour with the fewest free edges is
+// covered next. With at most 32 vertices, bitmasks stand in for the dancing
+// links.
+bool cover_matching(const GraphSequence &graph_sequence,
+                    MatchingState &state) {
+  int colours = graph_sequence.size();
+  state.edges_by_colour.resize(colours);
+  for (int k = 0; k < colours; ++k) {
+    state.edge_masks(graph_sequence[k], state.edges_by_colour[k]);
+  }
+  state.matching.resize(colours);
+  auto cover = [&](auto &&cover, uint32_t pending, uint32_t used) -> bool {
+    ++state.nodes;
+    if (pending == 0) {
+      return true;
+    }
+    int colour = 0;
+    int fewest = numeric_limits<int>::max();
+    for (uint32_t rest = pending; rest && fewest > 0; rest &= rest - 1) {
+      int count = ranges::count_if(
+          state.edges_by_colour[countr_zero(rest)],
+          [used](uint32_t edge) { return !(used & edge); });
+      if (count < fewest) {
+        fewest = count;
+        colour = countr_zero(rest);
+      }
+    }
+    for (uint32_t edge : state.edges_by_colour[colour]) {
+      if (!(used & edge) &&
+          cover(cover, pending & ~(1u << colour), used | edge)) {
+        state.matching[colour] = state.edge_of(edge);
+        return true;
+      }
+    }
+    return false;
+  };
+  return cover(cover, (1u << colours) - 1, 0);
+}
+
+// Whether `matching` takes one edge from each graph, pairwise disjoint.
+bool is_matching(const GraphCatalogue &catalogue,
+                 const GraphSequence &graph_sequence,
+                 const vector<pair<int, int>> &matching) {
+  vector<char> used_x(catalogue.s + 1), used_y(catalogue.s + 1);
+  for (const auto &[graph, edge] : views::zip(graph_sequence, matching)) {
+    auto [x, y] = edge;
+    if (!catalogue[graph].has_edge(x, y) || used_x[x] || used_y[y]) {
+      return false;
+    }
+    used_x[x] = used_y[y] = true;
+  }
+  return true;
+}
+
+// A rainbow matching of the graph sequence from a reset state, by the backend
+// state.backends has for its regime. The greedy+dfs backend tries
+// greedy_heuristic first and keeps its matching only once is_matching has
+// confirmed it; otherwise the DFS decides, so the heuristic never decides
+// alone. On success state.matching holds one edge per colour in
+// graph_sequence order.
+bool find_matching(const GraphSequence &graph_sequence, MatchingState &state) {
+  state.reset();
+  MatchingBackend backend = state.backends[state.regime(graph_sequence)];
+  if (backend == kSubsetDpBackend) {
+    return dp_matching(graph_sequence, state);
+  }
+  if (backend == kCoverBackend) {
+    return cover_matching(graph_sequence, state);
+  }
+  if (backend == kGreedyBackend) {
+    if (greedy_heuristic(graph_sequence, state) &&
+        is_matching(state.catalogue, graph_sequence, state.matching)) {
+      return true;
+    }
+    state.reset();
+  }
+  return gen_matching(graph_sequence.begin(), graph_sequence.end(), state);
+}
+
+generator<GraphSequence>
 gen_graph_sequences(input_iterator auto size_begin,
                     input_iterator auto size_end,
-                    const vector<vector<ShiftedGraph>> &graphs_by_size) {
+                    const GraphCatalogue &catalogue) {
   if (size_begin == size_end) {
     co_yield {};
   } else {
     // cerr << "Trying to generate graph sequences" << "\n";
     for (auto &&sequence :
-         gen_graph_sequences(next(size_begin), size_end, graphs_by_size)) {
-      for (auto &&graph : graphs_by_size[*size_begin]) {
+         gen_graph_sequences(next(size_begin), size_end, catalogue)) {
+      for (GraphId graph : catalogue.bucket(*size_begin)) {
         sequence.push_back(graph);
         co_yield sequence;
         sequence.pop_back();
@@ -120,27 +643,102 @@ gen_graph_sequences(input_iterator auto size_begin,
   }
 }
 
-void print_graph_sequence(
-    const vector<reference_wrapper<const ShiftedGraph>> &graph_sequence,
-    vector<pair<int, int>> matching = {}) {
+// One step of gen_graph_sequences_gray: the current graph sequence and the
+// colour whose graph differs from the previous step (-1 on the first step).
+struct GrayStep {
+  const GraphSequence &graphs;
+  int changed;
+};
+
+// The same graph sequences as gen_graph_sequences, in reflected mixed-radix
+// Gray-code order: exactly one colour changes its graph between consecutive
+// steps. Loopless, using Knuth's focus pointers (TAOCP 7.2.1.1, Algorithm H);
+// the last colour is the fastest digit, as in gen_graph_sequences. Colour
+// canonical_colour, if any, only takes the canonical graphs of its bucket.
+generator<GrayStep>
+gen_graph_sequences_gray(const vector<int> &size_sequence,
+                         const GraphCatalogue &catalogue,
+                         int canonical_colour = -1) {
+  vector<int> bucket_sizes;
+  GraphSequence sequence;
+  for (int size : size_sequence | views::reverse) {
+    if (catalogue.bucket_size(size) == 0) {
+      co_return;
+    }
+    bucket_sizes.push_back(sequence.size() == canonical_colour
+                               ? catalogue.canonical_size(size)
+                               : catalogue.bucket_size(size));
+    sequence.push_back(catalogue.bucket_begin[size]);
+  }
+  co_yield {sequence, -1};
+  // Colours with a single candidate graph never change.
+  vector<int> digits;
+  for (int c = (int)bucket_sizes.size() - 1; c >= 0; --c) {
+    if (bucket_sizes[c] > 1) {
+      digits.push_back(c);
+    }
+  }
+  int m = digits.size();
+  vector<int> a(m, 0), o(m, 1), f(m + 1);
+  iota(f.begin(), f.end(), 0);
+  while (true) {
+    int j = f[0];
+    f[0] = 0;
+    if (j == m) {
+      co_return;
+    }
+    a[j] += o[j];
+    int c = digits[j];
+    sequence[c] += o[j];
+    co_yield {sequence, c};
+    if (a[j] == 0 || a[j] + 1 == bucket_sizes[c]) {
+      o[j] = -o[j];
+      f[j] = f[j + 1];
+      f[j + 1] = j + 1;
+    }
+  }
+}
+
+// The colour of a graph sequence of these sizes whose restriction to
+// canonical graphs leaves the smallest fraction of its bucket, or -1. Every
+// graph sequence or its transpose has a canonical graph there, so only those
+// need a test.
+int canonical_colour(const vector<int> &size_sequence,
+                     const GraphCatalogue &catalogue) {
+  int res = -1;
+  double best = 1;
+  for (const auto &[c, size] :
+       size_sequence | views::reverse | views::enumerate) {
+    double kept = (double)catalogue.canonical_size(size) /
+                  max(1, catalogue.bucket_size(size));
+    if (kept < best) {
+      best = kept;
+      res = c;
+    }
+  }
+  return res;
+}
+
+void print_graph_sequence(const GraphCatalogue &catalogue,
+                          const GraphSequence &graph_sequence,
+                          vector<pair<int, int>> matching = {}) {
   cout << endl;
   // cout << "ANTIPATHS:\n";
   // for (const auto &graph : graph_sequence) {
-  //   for (const auto &[x, y] : graph.get().antipath) {
+  //   for (const auto &[x, y] : catalogue[graph].antipath) {
   //     cout << format("({},{})", x, y) << " ";
   //   }
   //   cout << endl;
   // }
-  int s = graph_sequence[0].get().s;
+  int s = catalogue.s;
   string alphabet = "ABCDEFGHIJKLMNOPQRST";
   for (int y = s + 1; y >= 0; --y) {
     cout << (y >= 1 ? alphabet[y - 1] : '.') << '|';
     for (const auto &[i, graph] :
          graph_sequence | views::enumerate | views::reverse) {
       auto [xm, ym] = (i < matching.size() ? matching[i] : pair{-1, -1});
-      int s = graph.get().s;
       int last_x0 = 1;
-      for (auto [x0, y0] : graph.get().edges()) {
+      for (auto [x0, y0] : catalogue[graph].edges()) {
         if (y0 == y) {
           for (; last_x0 < x0; ++last_x0) {
             cout << ' ';
@@ -164,132 +762,1460 @@ void print_graph_sequence(
   }
 }
 
-bool is_better(const vector<int> &lhs, const vector<int> &rhs) {
-  for (int i = 0; i < lhs.size(); ++i) {
-    if (lhs[i] < rhs[i]) {
+// The family of the certificate cache, the same as in drawer.cpp.
+constexpr string_view kCacheFamily = "2_partite";
+
+// find_matching behind the certificate cache. The cache is only consulted for
+// graph sequences the DFS does not decide within cache->min_nodes nodes,
+// cheaper ones are faster to recompute than to look up. On success
+// state.matching holds one edge per colour in graph_sequence order.
+bool cached_matching(const GraphSequence &graph_sequence, MatchingState &state,
+                     CertificateCache *cache) {
+  if (cache == nullptr) {
+    return find_matching(graph_sequence, state);
+  }
+  state.reset();
+  state.node_limit = state.nodes + cache->min_nodes;
+  bool matchable =
+      gen_matching(graph_sequence.begin(), graph_sequence.end(), state);
+  bool decided = state.nodes <= state.node_limit;
+  state.node_limit = numeric_limits<uint64_t>::max();
+  if (decided) {
+    return matchable;
+  }
+  const auto &catalogue = state.catalogue;
+  vector<int> order;
+  auto antipaths = views::transform(
+      graph_sequence, [&](GraphId graph) { return catalogue[graph].antipath; });
+  string key = canonical_key(catalogue.s, antipaths, order);
+  state.reset();
+  auto known = cache->lookup_matching(
+      key, order, state.matching, [&](const vector<pair<int, int>> &matching) {
+        return is_matching(catalogue, graph_sequence, matching);
+      });
+  if (known) {
+    return *known;
+  }
+  matchable = find_matching(graph_sequence, state);
+  cache->insert_matching(key, order, matchable, state.matching);
+  return matchable;
+}
+
+// Incremental update for a single changed colour, for a caller that walks
+// gen_graph_sequences_gray: state.matching is a matching of the previous
+// graph sequence, which differs from graph_sequence only in the graph of
+// colour `changed`. Keeps every other colour's edge and looks for an edge of
+// the new graph that fits, in O(s + edges of one graph) instead of a DFS.
+// Returns false if there is none, leaving state as it was. The search's sweep
+// decides whole buckets and has no use for it.
+bool repair_matching(const GraphSequence &graph_sequence, int changed,
+                     MatchingState &state) {
+  uint32_t others = 0;
+  for (const auto &[i, edge] : state.matching | views::enumerate) {
+    if (i != changed) {
+      others |= state.edge_bits(edge.first, edge.second);
+    }
+  }
+  auto graph = state.catalogue[graph_sequence[changed]];
+  auto edge = state.matching[changed];
+  if (!graph.has_edge(edge.first, edge.second)) {
+    auto edges = graph.edges();
+    auto it = ranges::find_if(edges, [&](const pair<int, int> &e) {
+      return (state.edge_bits(e.first, e.second) & others) == 0;
+    });
+    if (it == edges.end()) {
       return false;
     }
+    edge = *it;
+  }
+  auto previous = state.matching;
+  state.reset();
+  for (const auto &[i, e] : previous | views::enumerate) {
+    auto [x, y] = i == changed ? edge : e;
+    state.take(i, x, y);
   }
   return true;
 }
 
-void do_stuff(int s, const std::ranges::range auto &size_sequences,
-              const vector<vector<ShiftedGraph>> &graphs_by_size,
-              set<vector<int>> &results) {
-  for (const auto &size_sequence : size_sequences) {
-    bool best = true;
-    for (const auto &v : results) {
-      if (is_better(v, size_sequence)) {
-        best = false;
-        break;
-      }
+// Build with -DSIMD_SWEEP=0 for the scalar bucket sweep.
+#ifndef SIMD_SWEEP
+#define SIMD_SWEEP 1
+#endif
+
+// On x86-64 Linux the vector sweep is compiled twice, for AVX2 and for the
+// baseline SSE2, and the loader picks the one the CPU runs. Elsewhere the
+// vector extensions lower to whatever -march allows (NEON on aarch64).
+#if SIMD_SWEEP && defined(__x86_64__) && defined(__linux__)
+#define SWEEP_TARGETS __attribute__((target_clones("avx2", "default")))
+#else
+#define SWEEP_TARGETS
+#endif
+
+// The last colour of every graph sequence of a size sequence is decided for a
+// whole bucket at once. A shifted bipartite graph has an edge avoiding vertex
+// sets of both sides iff it contains the edge (fx, fy) on the smallest free x
+// and the smallest free y, and contains (a, b) iff cap(a) >= b, where cap(a)
+// is the largest neighbour of a. So all that matters about a prefix of the
+// graph sequence is need[a], the smallest fy over the prefix's matchings
+// leaving fx = a, and a graph completes the prefix iff cap(a) >= need[a] for
+// some a.
+constexpr int kSweepLanes = 32;
+typedef uint8_t CapBlock __attribute__((vector_size(kSweepLanes)));
+
+// cap(a) of every graph of a bucket, stored per vertex a in blocks of
+// kSweepLanes graphs. Lanes past the end of the bucket pass every test.
+struct BucketCaps {
+  int vertices;
+  int blocks;
+  vector<CapBlock> caps; // caps[a * blocks + block]
+
+  BucketCaps(const GraphCatalogue &catalogue, int size)
+      : vertices(catalogue.s + 1),
+        blocks((catalogue.bucket_size(size) + kSweepLanes - 1) / kSweepLanes),
+        caps(vertices * blocks) {
+    for (auto &block : caps) {
+      block = CapBlock{} + 0xff;
     }
-    if (!best) {
-      continue;
+    for (const auto &[g, graph] : catalogue.bucket(size) | views::enumerate) {
+      for (int a = 0; a < vertices; ++a) {
+        caps[a * blocks + g / kSweepLanes][g % kSweepLanes] = 0;
+      }
+      int x = 1;
+      for (auto [x0, y0] : catalogue[graph].antipath) {
+        for (; x <= x0; ++x) {
+          caps[x * blocks + g / kSweepLanes][g % kSweepLanes] = y0;
+        }
+      }
     }
-    // cerr << "Checking sequence ";
-    // for (const int &x : size_sequence) {
-    // cerr << x << " ";
-    // }
-    // cerr << "\n";
-    MatchingState state(s);
-    for (const auto &graph_sequence : gen_graph_sequences(
-             size_sequence.begin(), size_sequence.end(), graphs_by_size)) {
-      state.reset();
-      if (gen_matching(graph_sequence.begin(), graph_sequence.end(), state)) {
-        // print_graph_sequence(graph_sequence);
-#if 0
-        cout << '{';
-        for (auto it = size_sequence.begin(); next(it) != size_sequence.end();
-             ++it) {
-          cout << *it << ',';
-        }
-        cout << size_sequence.back();
-        cout << '}' << "\n";
-        ;
-        cerr << "admits a matching" << "\n";
-        for (auto [x, y] : *matching) {
-          cerr << format("({}, {}) ", x, y);
-        }
-        cerr << "\n" << "of a corresponding ";
-        print_graph_sequence(graph_sequence);
+  }
+
+  // The index of the first graph that completes no prefix matching, or -1.
+  SWEEP_TARGETS int first_failure(const vector<uint8_t> &need) const {
+    for (int block = 0; block < blocks; ++block) {
+#if SIMD_SWEEP
+      CapBlock pass{};
+      for (int a = 0; a < vertices; ++a) {
+        pass |= (CapBlock)(caps[a * blocks + block] >= need[a]);
+      }
+      for (int lane = 0; lane < kSweepLanes; ++lane) {
+        if (!pass[lane]) {
+          return block * kSweepLanes + lane;
+        }
+      }
+#else
+      for (int lane = 0; lane < kSweepLanes; ++lane) {
+        bool pass = false;
+        for (int a = 0; a < vertices && !pass; ++a) {
+          pass = caps[a * blocks + block][lane] >= need[a];
+        }
+        if (!pass) {
+          return block * kSweepLanes + lane;
+        }
+      }
 #endif
-        // cout << "BREAKING BREAKING BREAKING" << "\n";
-        // results->push_back(move(size_sequence));
+    }
+    return -1;
+  }
+
+  // Whether graph g of the bucket completes some prefix matching.
+  bool completes(int g, const vector<uint8_t> &need) const {
+    for (int a = 0; a < vertices; ++a) {
+      if (caps[a * blocks + g / kSweepLanes][g % kSweepLanes] >= need[a]) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // completes[g] for every graph g of the bucket: whether it completes some
+  // prefix matching.
+  void completions(const vector<uint8_t> &need, vector<char> &completes) const {
+    completes.assign(blocks * kSweepLanes, false);
+    for (int block = 0; block < blocks; ++block) {
+      for (int lane = 0; lane < kSweepLanes; ++lane) {
+        char &pass = completes[block * kSweepLanes + lane];
+        for (int a = 0; a < vertices && !pass; ++a) {
+          pass = caps[a * blocks + block][lane] >= need[a];
+        }
+      }
+    }
+  }
+};
+
+// The containment order of the catalogue, for the search restricted to
+// chains G_1 <= G_2 <= ... of graphs: above[above_begin[g], above_begin[g +
+// 1]) are the graphs containing graph g, g itself included, by id, so those
+// of one size form a run.
+struct ContainmentLattice {
+  vector<uint32_t> above_begin;
+  vector<GraphId> above;
+
+  explicit ContainmentLattice(const GraphCatalogue &catalogue) {
+    int graph_count = catalogue.bucket_begin.back();
+    int words = (catalogue.max_size() + 63) / 64;
+    vector<uint64_t> edges(graph_count * words);
+    for (int g = 0; g < graph_count; ++g) {
+      for (auto [x, y] : catalogue[g].edges()) {
+        int edge = (x - 1) * catalogue.s + y - 1;
+        edges[g * words + edge / 64] |= 1ull << edge % 64;
+      }
+    }
+    above_begin.push_back(0);
+    for (int g = 0; g < graph_count; ++g) {
+      for (int h = g; h < graph_count; ++h) {
+        bool inside = true;
+        for (int w = 0; w < words && inside; ++w) {
+          inside = !(edges[g * words + w] & ~edges[h * words + w]);
+        }
+        if (inside) {
+          above.push_back(h);
+        }
+      }
+      above_begin.push_back(above.size());
+    }
+  }
+
+  // The graphs with `size` edges containing `graph`.
+  span<const GraphId> above_in(const GraphCatalogue &catalogue, GraphId graph,
+                               int size) const {
+    span<const GraphId> all(above.data() + above_begin[graph],
+                            above.data() + above_begin[graph + 1]);
+    return {ranges::lower_bound(all, catalogue.bucket_begin[size]),
+            ranges::lower_bound(all, catalogue.bucket_begin[size + 1])};
+  }
+};
+
+// Vertex sets covered by rainbow matchings of a prefix of a graph sequence:
+// layers[k] is a bitset over all subsets of the 2s vertices (x is bit x - 1,
+// y is bit s + y - 1) reachable after colours 0..k. The sweep chooses the
+// colours depth-first, so recompute only redoes the layers from the colour it
+// chose.
+struct PrefixMatchings {
+  const GraphCatalogue &catalogue;
+  int s;
+  int words;
+  vector<vector<uint64_t>> layers;
+
+  PrefixMatchings(const GraphCatalogue &catalogue, int colours)
+      : catalogue(catalogue), s(catalogue.s),
+        words(max(1, (1 << (2 * s)) / 64)),
+        layers(colours, vector<uint64_t>(words)) {}
+
+  static inline const vector<uint64_t> empty_set = {1};
+
+  // The vertex sets of the matchings of the colours behind `prev` extended
+  // by an edge of `graph`.
+  void extend(const vector<uint64_t> &prev, GraphId graph,
+              vector<uint64_t> &layer) const {
+    layer.assign(words, 0);
+    for (int word = 0; word < prev.size(); ++word) {
+      for (uint64_t bits = prev[word]; bits; bits &= bits - 1) {
+        uint32_t used = word * 64 + countr_zero(bits);
+        int x = 1;
+        for (auto [x0, y0] : catalogue[graph].antipath) {
+          for (; x <= x0; ++x) {
+            if (used >> (x - 1) & 1) {
+              continue;
+            }
+            for (int y = 1; y <= y0; ++y) {
+              if (!(used >> (s + y - 1) & 1)) {
+                uint32_t next = used | 1u << (x - 1) | 1u << (s + y - 1);
+                layer[next / 64] |= 1ull << (next % 64);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  void recompute(const GraphSequence &prefix, int from) {
+    for (int k = from; k < prefix.size(); ++k) {
+      extend(k == 0 ? empty_set : layers[k - 1], prefix[k], layers[k]);
+    }
+  }
+
+  // Most edges a shifted graph can have without the edge (fx, fy).
+  int blocked(int fx, int fy) const {
+    return s * s - (s - fx + 1) * (s - fy + 1);
+  }
+
+  // Whether some matching of colours 0..k extends to all later colours by
+  // taking the edge (fx, fy) of each, which every graph of more than
+  // blocked(fx, fy) edges has.
+  bool completes_any(const vector<uint64_t> &layer, int k,
+                     const vector<int> &sizes) const {
+    for (int word = 0; word < layer.size(); ++word) {
+      for (uint64_t bits = layer[word]; bits; bits &= bits - 1) {
+        uint32_t used = word * 64 + countr_zero(bits);
+        bool completes = true;
+        for (int t = k + 1; t < sizes.size() && completes; ++t) {
+          int fx = countr_one(used) + 1;
+          int fy = countr_one(used >> s) + 1;
+          completes = sizes[t] > blocked(fx, fy);
+          used |= 1u << (fx - 1) | 1u << (s + fy - 1);
+        }
+        if (completes) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  // need[a] for a prefix with the matchings `layer`, 0xff where none leaves
+  // fx = a.
+  void required_caps(const vector<uint64_t> &layer,
+                     vector<uint8_t> &need) const {
+    need.assign(s + 1, 0xff);
+    for (int word = 0; word < layer.size(); ++word) {
+      for (uint64_t bits = layer[word]; bits; bits &= bits - 1) {
+        uint32_t used = word * 64 + countr_zero(bits);
+        int fx = countr_one(used) + 1;
+        int fy = countr_one(used >> s) + 1;
+        need[fx] = min<int>(need[fx], fy);
+      }
+    }
+  }
+};
+
+// Decides a size sequence by a depth-first walk over the graphs of all colours
+// but the last one, growing the prefix matchings a colour at a time, and a
+// bucket sweep for the last one. A prefix without a rainbow matching fails
+// with every completion, and one with a matching that the sizes of the later
+// colours alone let extend greedily passes with every completion; neither
+// subtree is walked. Returns whether some graph sequence has no rainbow
+// matching. With `chains` every colour after the first only takes the graphs
+// containing the one before it.
+bool sweep_fails(const vector<int> &size_sequence,
+                 const GraphCatalogue &catalogue,
+                 const vector<BucketCaps> &caps_by_size, SearchStats &stats,
+                 const ContainmentLattice *chains) {
+  vector<int> sizes(size_sequence.rbegin(), size_sequence.rend());
+  int colours = sizes.size();
+  const auto &last_caps = caps_by_size[sizes.back()];
+  int canonical = canonical_colour(
+      vector<int>(size_sequence.begin() + 1, size_sequence.end()), catalogue);
+  PrefixMatchings prefix_matchings(catalogue, colours - 1);
+  GraphSequence prefix;
+  vector<uint8_t> need;
+  auto fails = [&](auto &&fails, int k) -> bool {
+    if (k == colours - 1) {
+      prefix_matchings.required_caps(
+          k == 0 ? PrefixMatchings::empty_set : prefix_matchings.layers[k - 1],
+          need);
+      stats.bump(kBucketSweeps);
+      if (chains != nullptr && k > 0) {
+        auto above = chains->above_in(catalogue, prefix[k - 1], sizes.back());
+        stats.bump(kGraphSequences, above.size());
+        return ranges::any_of(above, [&](GraphId graph) {
+          return !last_caps.completes(
+              graph - catalogue.bucket_begin[sizes.back()], need);
+        });
+      }
+      stats.bump(kGraphSequences, catalogue.bucket_size(sizes.back()));
+      return last_caps.first_failure(need) >= 0;
+    }
+    int end = catalogue.bucket_begin[sizes[k]] +
+              (k == canonical ? catalogue.canonical_size(sizes[k])
+                              : catalogue.bucket_size(sizes[k]));
+    auto visit = [&](int graph) {
+      prefix.push_back(graph);
+      prefix_matchings.recompute(prefix, k);
+      bool failed;
+      if (ranges::all_of(prefix_matchings.layers[k],
+                         [](uint64_t word) { return word == 0; })) {
+        failed = true;
+      } else if (prefix_matchings.completes_any(prefix_matchings.layers[k], k,
+                                                 sizes)) {
+        stats.bump(kPrefixPrunes);
+        failed = false;
       } else {
-        vector<vector<int>> to_remove;
-        for (const auto &cand : results) {
-          if (is_better(size_sequence, cand)) {
-            to_remove.push_back(cand);
+        failed = fails(fails, k + 1);
+      }
+      prefix.pop_back();
+      return failed;
+    };
+    if (chains != nullptr && k > 0) {
+      return ranges::any_of(
+          chains->above_in(catalogue, prefix[k - 1], sizes[k]),
+          [&](GraphId graph) { return graph < end && visit(graph); });
+    }
+    for (int graph = catalogue.bucket_begin[sizes[k]]; graph < end; ++graph) {
+      if (visit(graph)) {
+        return true;
+      }
+    }
+    return false;
+  };
+  return fails(fails, 0);
+}
+
+// Counts the graph sequences of a size sequence that start with `first`: all
+// of them, those without a rainbow matching and the minimal ones among those,
+// which have a matching once any one colour is left out. Sequences with a
+// common prefix share its layers, and next to them the walk keeps the layers
+// of the prefix without each one of its colours. The last colour is counted a
+// bucket at a time, and a prefix without a matching, or with one that surely
+// extends, settles all its completions at once.
+FailureCounts count_failures(const vector<int> &size_sequence, GraphId first,
+                             const GraphCatalogue &catalogue,
+                             const vector<BucketCaps> &caps_by_size) {
+  vector<int> sizes(size_sequence.rbegin(), size_sequence.rend());
+  int colours = sizes.size();
+  // completions[k]: the number of graph sequences of colours k..
+  vector<uint64_t> completions(colours + 1, 1);
+  for (int k = colours - 1; k >= 0; --k) {
+    completions[k] = completions[k + 1] * catalogue.bucket_size(sizes[k]);
+  }
+  int last_size = catalogue.bucket_size(sizes.back());
+  PrefixMatchings prefix_matchings(catalogue, 0);
+  vector<uint8_t> need;
+  const auto &last_caps = caps_by_size[sizes.back()];
+  auto mark_completions = [&](const vector<uint64_t> &layer,
+                              vector<char> &completes) {
+    prefix_matchings.required_caps(layer, need);
+    last_caps.completions(need, completes);
+  };
+  // layers[k] holds the matchings of colours 0..k-1, without[k][i] those of
+  // the same colours but i.
+  vector<vector<uint64_t>> layers(colours, PrefixMatchings::empty_set);
+  vector<vector<vector<uint64_t>>> without(colours,
+                                           vector<vector<uint64_t>>(colours));
+  auto empty = [](const vector<uint64_t> &layer) {
+    return ranges::all_of(layer, [](uint64_t word) { return word == 0; });
+  };
+  vector<char> completes, completes_without, minimal;
+  FailureCounts res;
+  // `maybe_minimal` is false once the prefix without one of its colours
+  // already has no matching.
+  auto count = [&](auto &&count, int k, bool maybe_minimal) -> void {
+    if (k == colours - 1) {
+      res.tuples += last_size;
+      mark_completions(layers[k], completes);
+      minimal.assign(last_size, maybe_minimal && !empty(layers[k]));
+      for (int i = 0; i < k && maybe_minimal; ++i) {
+        mark_completions(without[k][i], completes_without);
+        for (int g = 0; g < last_size; ++g) {
+          minimal[g] = minimal[g] && completes_without[g];
+        }
+      }
+      for (int g = 0; g < last_size; ++g) {
+        if (!completes[g]) {
+          ++res.failing;
+          res.minimal += minimal[g];
+        }
+      }
+      return;
+    }
+    int begin = (k == 0 ? first : catalogue.bucket_begin[sizes[k]]);
+    int end = (k == 0 ? first + 1 : catalogue.bucket_begin[sizes[k] + 1]);
+    for (int graph = begin; graph < end; ++graph) {
+      prefix_matchings.extend(layers[k], graph, layers[k + 1]);
+      if (empty(layers[k + 1])) {
+        res.tuples += completions[k + 1];
+        res.failing += completions[k + 1];
+        continue;
+      }
+      if (prefix_matchings.completes_any(layers[k + 1], k, sizes)) {
+        res.tuples += completions[k + 1];
+        continue;
+      }
+      bool still_minimal = maybe_minimal;
+      for (int i = 0; i < k && still_minimal; ++i) {
+        prefix_matchings.extend(without[k][i], graph, without[k + 1][i]);
+        still_minimal = !empty(without[k + 1][i]);
+      }
+      without[k + 1][k] = layers[k];
+      count(count, k + 1, still_minimal);
+    }
+  };
+  count(count, 0, true);
+  return res;
+}
+
+// Times every backend on the same random graph sequences of each regime and
+// picks the fastest one. The graph sequences are drawn uniformly from
+// uniformly drawn size sequences; a regime none of them falls into keeps the
+// DFS. Every backend must agree with the DFS on every graph sequence; on the
+// first that one does not, it is reported and nothing is returned. The DFS
+// forgets its nogoods before every timed round, so that no round profits
+// from an earlier one. Only --check and --sample calibrate, see
+// choose_backends; the search's sweep does not go through a backend at all.
+optional<BackendChoice> calibrate_backends(const GraphCatalogue &catalogue,
+                                           uint64_t seed) {
+  constexpr int kDraws = 4096;
+  constexpr int kSamplesPerRegime = 64;
+  constexpr int kRounds = 3;
+  SizeSequenceRanking ranking(catalogue.s, catalogue.max_size());
+  mt19937_64 rng(seed);
+  MatchingState state(catalogue);
+  array<vector<GraphSequence>, kRegimes> samples;
+  for (int draw = 0; draw < kDraws; ++draw) {
+    auto size_sequence = ranking.unrank(rng() % ranking.size());
+    GraphSequence graph_sequence;
+    for (int size : size_sequence | views::reverse) {
+      if (catalogue.bucket_size(size) > 0) {
+        graph_sequence.push_back(catalogue.bucket_begin[size] +
+                                 rng() % catalogue.bucket_size(size));
+      }
+    }
+    auto &regime = samples[state.regime(graph_sequence)];
+    if (graph_sequence.size() == size_sequence.size() &&
+        regime.size() < kSamplesPerRegime) {
+      regime.push_back(graph_sequence);
+    }
+  }
+  BackendChoice res{};
+  for (int regime = 0; regime < kRegimes; ++regime) {
+    vector<char> expected;
+    double fastest = numeric_limits<double>::infinity();
+    for (int backend = 0; backend < kBackendCount; ++backend) {
+      state.backends.fill((MatchingBackend)backend);
+      vector<char> matched;
+      double seconds = numeric_limits<double>::infinity();
+      for (int round = 0; round < kRounds; ++round) {
+        matched.clear();
+        state.nogoods.clear();
+        auto start = chrono::steady_clock::now();
+        for (const auto &graph_sequence : samples[regime]) {
+          matched.push_back(find_matching(graph_sequence, state) &&
+                            is_matching(catalogue, graph_sequence,
+                                        state.matching));
+        }
+        seconds = min(seconds, chrono::duration<double>(
+                                   chrono::steady_clock::now() - start)
+                                   .count());
+      }
+      if (backend == kDfsBackend) {
+        expected = matched;
+      } else if (auto [it, _] = ranges::mismatch(matched, expected);
+                 it != matched.end()) {
+        const auto &graph_sequence = samples[regime][it - matched.begin()];
+        cerr << format("matching backend {} finds {} where dfs finds {}:",
+                       backend_names[backend], *it ? "a matching" : "none",
+                       *it ? "none" : "one");
+        for (const auto &[i, graph] :
+             graph_sequence | views::reverse | views::enumerate) {
+          cerr << (i ? " |" : "");
+          for (auto [x, y] : catalogue[graph].antipath) {
+            cerr << " " << (int)x << "," << (int)y;
           }
         }
-        for (const auto &tmp : to_remove) {
-          results.erase(tmp);
+        cerr << "\n";
+        return nullopt;
+      }
+      if (!samples[regime].empty() && seconds < fastest) {
+        fastest = seconds;
+        res[regime] = (MatchingBackend)backend;
+      }
+    }
+  }
+  return res;
+}
+
+// Tests size sequences on random graph sequences instead of all of them, for
+// s beyond exhaustive reach: a failure comes with its witness, a pass is only
+// a guess. The uniform sampler draws every graph of a bucket alike. The
+// biased one favours staircases with few corners and repeats the previous
+// colour's graph for an equal size with probability 1/2, the shape of most
+// known witnesses. One sampler per worker.
+struct TupleSampler {
+  const GraphCatalogue &catalogue;
+  uint64_t samples;
+  bool biased;
+  mt19937_64 rng;
+  vector<discrete_distribution<int>> by_size;
+  MatchingState state;
+
+  TupleSampler(const GraphCatalogue &catalogue, uint64_t samples, bool biased,
+               uint64_t seed, const BackendChoice &backends)
+      : catalogue(catalogue), samples(samples), biased(biased), rng(seed),
+        state(catalogue) {
+    state.backends = backends;
+    for (int size = 0; size <= catalogue.max_size(); ++size) {
+      vector<double> weights;
+      for (GraphId graph : catalogue.bucket(size)) {
+        int corners = catalogue[graph].antipath.size();
+        weights.push_back(biased ? ldexp(1.0, -corners) : 1.0);
+      }
+      by_size.emplace_back(weights.begin(), weights.end());
+    }
+  }
+
+  void draw(const vector<int> &size_sequence, GraphSequence &graph_sequence) {
+    graph_sequence = {};
+    int last_size = -1;
+    for (int size : size_sequence | views::reverse) {
+      if (biased && size == last_size && rng() % 2) {
+        graph_sequence.push_back(graph_sequence.back());
+      } else {
+        graph_sequence.push_back(catalogue.bucket_begin[size] +
+                                 by_size[size](rng));
+      }
+      last_size = size;
+    }
+  }
+
+  // Whether one of `samples` random graph sequences has no rainbow matching,
+  // which is then left in `witness`.
+  bool fails(const vector<int> &size_sequence, SearchStats &stats,
+             GraphSequence &witness) {
+    for (int size : size_sequence) {
+      if (catalogue.bucket_size(size) == 0) {
+        return false;
+      }
+    }
+    for (uint64_t i = 0; i < samples; ++i) {
+      draw(size_sequence, witness);
+      stats.bump(kGraphSequences);
+      bool matched = find_matching(witness, state);
+      stats.bump(kMatchingNodes, state.nodes);
+      state.nodes = 0;
+      if (!matched) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+// The first graph sequence of the given sizes without a rainbow matching.
+optional<GraphSequence>
+find_witness(const vector<int> &size_sequence,
+             const GraphCatalogue &catalogue, MatchingState &state,
+             CertificateCache *cache = nullptr) {
+  for (const auto &graph_sequence : gen_graph_sequences(
+           size_sequence.begin(), size_sequence.end(), catalogue)) {
+    if (!cached_matching(graph_sequence, state, cache)) {
+      return graph_sequence;
+    }
+  }
+  return nullopt;
+}
+
+// One line per frontier row: the sizes, then the antipath of every graph of
+// the witness in the same order, e.g. `5 1 : 4,2 | 2,1`.
+void write_witness(ostream &out, const GraphCatalogue &catalogue,
+                   const vector<int> &size_sequence,
+                   const GraphSequence &witness) {
+  for (int size : size_sequence) {
+    out << size << " ";
+  }
+  out << ":";
+  for (const auto &[i, graph] : witness | views::reverse | views::enumerate) {
+    out << (i ? " |" : "");
+    for (auto [x, y] : catalogue[graph].antipath) {
+      out << " " << (int)x << "," << (int)y;
+    }
+  }
+  out << "\n";
+}
+
+// Lines that cannot be parsed or name graphs outside the catalogue are
+// reported, counted in `rejected` and skipped.
+map<vector<int>, GraphSequence>
+read_witnesses(istream &in, const GraphCatalogue &catalogue, int &rejected) {
+  map<vector<int>, GraphSequence> res;
+  string line;
+  while (getline(in, line)) {
+    auto colon = line.find(':');
+    if (colon == string::npos) {
+      continue;
+    }
+    vector<int> size_sequence;
+    {
+      istringstream ss(line.substr(0, colon));
+      int n;
+      while (ss >> n) {
+        size_sequence.push_back(n);
+      }
+    }
+    vector<vector<pair<int, int>>> antipaths(1);
+    {
+      istringstream ss(line.substr(colon + 1));
+      string token;
+      while (ss >> token) {
+        if (token == "|") {
+          antipaths.emplace_back();
+        } else {
+          auto comma = token.find(',');
+          antipaths.back().emplace_back(stoi(token.substr(0, comma)),
+                                        stoi(token.substr(comma + 1)));
         }
-        results.insert(size_sequence);
+      }
+    }
+    if (antipaths.size() != size_sequence.size()) {
+      cerr << "malformed witness: " << line << "\n";
+      ++rejected;
+      continue;
+    }
+    // Witness graphs are looked up in the catalogue, so a witness naming a
+    // graph that is not shifted or has the wrong size is rejected here.
+    GraphSequence witness;
+    for (auto [size, antipath] :
+         views::zip(size_sequence, antipaths) | views::reverse) {
+      if (size < 0 || size > catalogue.max_size()) {
         break;
       }
+      auto bucket = catalogue.bucket(size);
+      auto it = ranges::find_if(bucket, [&](GraphId graph) {
+        return ranges::equal(catalogue[graph].antipath, antipath,
+                             [](Corner lhs, pair<int, int> rhs) {
+                               return lhs.first == rhs.first &&
+                                      lhs.second == rhs.second;
+                             });
+      });
+      if (it == bucket.end()) {
+        break;
+      }
+      witness.push_back(*it);
+    }
+    if (witness.size() != size_sequence.size()) {
+      cerr << "witness does not match the catalogue: " << line << "\n";
+      ++rejected;
+      continue;
     }
+    res.emplace(move(size_sequence), move(witness));
   }
+  return res;
 }
 
-int main(int argc, const char *argv[]) {
-  int s;
-  cin >> s;
-  cout << s << endl;
-  auto size_sequences = gen_size_sequence(s, s, 1) | ranges::to<vector>();
-  vector<vector<ShiftedGraph>> graphs_by_size(s * s + 1);
-  for (auto &&graph : gen_graphs(s, 1, s)) {
-    ranges::reverse(graph.antipath);
-    auto edges = graph.edges();
-    graphs_by_size[std::ranges::distance(edges.begin(), edges.end())].push_back(
-        move(graph));
+// A worker of check_frontier: stored witnesses are tested with the chosen
+// backends, missing ones looked up through the certificate cache.
+struct WitnessWorker {
+  const GraphCatalogue &catalogue;
+  CertificateCache *cache;
+  MatchingState state;
+
+  WitnessWorker(const GraphCatalogue &catalogue, CertificateCache *cache,
+                const BackendChoice &backends)
+      : catalogue(catalogue), cache(cache), state(catalogue) {
+    state.backends = backends;
   }
-  int thread_count = (argc == 1 ? min((int)thread::hardware_concurrency(),
-                                      (int)size_sequences.size())
-                                : stoi(argv[1]));
-  vector<set<vector<int>>> results(thread_count);
+
+  bool unmatchable(const GraphSequence &witness) {
+    return !find_matching(witness, state);
+  }
+
+  optional<GraphSequence> find_witness(const vector<int> &size_sequence) {
+    return ::find_witness(size_sequence, catalogue, state, cache);
+  }
+};
+
+// Cross-checks greedy_heuristic against gen_matching on every multiset of s
+// graphs (the order of the colours does not matter), so it is only practical
+// for small s. This is the record of the heuristic's error rate: at s = 3 it
+// misses 19 of 1540 multisets. Returns whether it missed none.
+bool validate_greedy(const GraphCatalogue &catalogue, int thread_count) {
+  int s = catalogue.s;
+  GraphId graph_count = catalogue.bucket_begin.back();
+  atomic<int> next_first = 0;
+  atomic<uint64_t> sequences = 0, unmatchable = 0, missed = 0, wrong = 0;
+  mutex mtx;
+  optional<GraphSequence> first_miss;
   {
     vector<jthread> threads;
     for (int i = 0; i < thread_count; ++i) {
-      threads.emplace_back(
-          [s, i, thread_count, &size_sequences, &graphs_by_size, &results] {
-            do_stuff(s,
-                     size_sequences | views::reverse | views::drop(i) |
-                         views::stride(thread_count),
-                     graphs_by_size, results[i]);
-          });
-    }
-  }
-  set<vector<int>> total = move(results[0]);
-  for (const auto &thrd : results | views::drop(1)) {
-    for (const auto &seq : thrd) {
-      bool best = true;
-      for (const auto &cand : total) {
-        if (is_better(cand, seq)) {
-          best = false;
-          continue;
+      threads.emplace_back([&] {
+        MatchingState state(catalogue);
+        GraphSequence graph_sequence;
+        auto visit = [&](auto &visit, GraphId from) -> void {
+          if (graph_sequence.size() == s) {
+            ++sequences;
+            bool greedy = greedy_heuristic(graph_sequence, state);
+            if (greedy &&
+                !is_matching(catalogue, graph_sequence, state.matching)) {
+              ++wrong;
+            }
+            state.reset();
+            if (!gen_matching(graph_sequence.begin(), graph_sequence.end(),
+                              state)) {
+              ++unmatchable;
+            } else if (!greedy) {
+              ++missed;
+              lock_guard lock(mtx);
+              if (!first_miss) {
+                first_miss = graph_sequence;
+              }
+            }
+            return;
+          }
+          for (GraphId graph = from; graph < graph_count; ++graph) {
+            graph_sequence.push_back(graph);
+            visit(visit, graph);
+            graph_sequence.pop_back();
+          }
+        };
+        for (int first; (first = next_first++) < graph_count;) {
+          graph_sequence.push_back(first);
+          visit(visit, first);
+          graph_sequence.pop_back();
         }
+      });
+    }
+  }
+  cerr << format("{} graph sequences, {} without a rainbow matching, {} "
+                 "matchings missed and {} invalid ones by greedy_heuristic\n",
+                 sequences.load(), unmatchable.load(), missed.load(),
+                 wrong.load());
+  if (first_miss) {
+    vector<int> sizes;
+    for (GraphId graph : *first_miss | views::reverse) {
+      sizes.push_back(ranges::distance(catalogue[graph].edges()));
+    }
+    cerr << "first missed: ";
+    write_witness(cerr, catalogue, sizes, *first_miss);
+  }
+  return missed == 0 && wrong == 0;
+}
+
+struct BenchResult {
+  string name;
+  uint64_t iterations;
+  uint64_t items;
+  double ns_per_iteration;
+  double min_ns;
+};
+
+// Repeats `body` (which returns the number of items it processed) until at
+// least `budget` seconds have passed.
+BenchResult run_bench(const string &name, auto &&body, double budget = 0.5) {
+  BenchResult res{name, 0, 0, 0, numeric_limits<double>::infinity()};
+  double total = 0;
+  while (total < budget || res.iterations < 3) {
+    auto start = chrono::steady_clock::now();
+    uint64_t items = body();
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() -
+                                               start)
+                    .count();
+    res.items = items;
+    res.min_ns = min(res.min_ns, ns);
+    total += ns / 1e9;
+    ++res.iterations;
+  }
+  res.ns_per_iteration = total * 1e9 / res.iterations;
+  cerr << format("{:<32} {:>12.0f} ns/iter {:>12.0f} ns min {:>10} items\n",
+                 name, res.ns_per_iteration, res.min_ns, res.items);
+  return res;
+}
+
+// Micro-benchmarks of the search kernels. The frontier of the same s (the
+// contents of results/<s>max.txt after its first line) provides fixed failing
+// tuples (the first failing tuple of every row) and passing ones (tuples of
+// the rows' minimal increments).
+void run_benchmarks(const GraphCatalogue &catalogue,
+                    const vector<vector<int>> &frontier, const string &path) {
+  constexpr int kMaxRows = 16;
+  constexpr int kTuplesPerIncrement = 16;
+  int s = catalogue.s;
+  int max_size = catalogue.max_size();
+  SizeSequenceRanking ranking(s, max_size);
+  vector<GraphSequence> failing, passing;
+  vector<vector<int>> increments;
+  MatchingState state(catalogue);
+  for (const auto &row : frontier | views::take(kMaxRows)) {
+    if (auto witness = find_witness(row, catalogue, state)) {
+      failing.push_back(move(*witness));
+    }
+    for (const auto &inc : minimal_increments(row, max_size)) {
+      increments.push_back(inc);
+      for (const auto &graph_sequence :
+           gen_graph_sequences(inc.begin(), inc.end(), catalogue) |
+               views::take(kTuplesPerIncrement)) {
+        passing.push_back(graph_sequence);
       }
-      if (!best) {
-        continue;
-      }
-      vector<vector<int>> to_remove;
-      for (const auto &cand : total) {
-        if (is_better(seq, cand)) {
-          to_remove.push_back(cand);
+    }
+  }
+  // The size sequence with the most graph sequences below a cap, so that one
+  // iteration of the enumeration benchmark stays short.
+  vector<int> enumerated = frontier.front();
+  double best_count = 0;
+  for (const auto &row : frontier) {
+    double count = 1;
+    for (int size : row) {
+      count *= catalogue.bucket_size(size);
+    }
+    if (count <= 1e6 && count > best_count) {
+      best_count = count;
+      enumerated = row;
+    }
+  }
+  // The largest bucket, swept against needs that only one vertex meets, so
+  // that every graph is compared at every vertex.
+  int largest = ranges::max(views::iota(0, max_size + 1), {}, [&](int size) {
+    return catalogue.bucket_size(size);
+  });
+  BucketCaps largest_caps(catalogue, largest);
+  vector<uint8_t> need(largest_caps.vertices, 0xff);
+  vector<vector<int>> antichain_input = frontier;
+  antichain_input.insert(antichain_input.end(), increments.begin(),
+                         increments.end());
+  ranges::shuffle(antichain_input, mt19937(1));
+
+  vector<BenchResult> results;
+  results.push_back(run_bench("gen_graphs", [s] {
+    return ranges::distance(gen_graphs(s, 1, s));
+  }));
+  results.push_back(run_bench("size_sequence_ranking", [&ranking] {
+    uint64_t round_trips = 0;
+    for (uint64_t rank = 0; rank < ranking.size(); ++rank) {
+      round_trips += ranking.rank(ranking.unrank(rank)) == rank;
+    }
+    return round_trips;
+  }));
+  results.push_back(run_bench("gen_graph_sequences", [&] {
+    return ranges::distance(gen_graph_sequences(
+        enumerated.begin(), enumerated.end(), catalogue));
+  }));
+  results.push_back(run_bench("gen_graph_sequences_gray", [&] {
+    return ranges::distance(gen_graph_sequences_gray(enumerated, catalogue));
+  }));
+  results.push_back(run_bench("repair_matching/gray", [&] {
+    uint64_t walked = 0;
+    bool matched = false;
+    for (const auto &[graph_sequence, changed] :
+         gen_graph_sequences_gray(enumerated, catalogue) |
+             views::take(1 << 16)) {
+      bool repair = matched && changed >= 0 &&
+                    repair_matching(graph_sequence, changed, state);
+      matched = repair || find_matching(graph_sequence, state);
+      ++walked;
+    }
+    return walked;
+  }));
+  results.push_back(run_bench("first_failure/largest_bucket", [&] {
+    uint64_t passed = 0;
+    for (auto &met : need) {
+      met = 0;
+      int g = largest_caps.first_failure(need);
+      passed += g < 0 ? catalogue.bucket_size(largest) : g;
+      met = 0xff;
+    }
+    return passed;
+  }));
+  results.push_back(run_bench("gen_matching/failing", [&] {
+    for (const auto &graph_sequence : failing) {
+      state.reset();
+      gen_matching(graph_sequence.begin(), graph_sequence.end(), state);
+    }
+    return failing.size();
+  }));
+  results.push_back(run_bench("gen_matching/passing", [&] {
+    for (const auto &graph_sequence : passing) {
+      state.reset();
+      gen_matching(graph_sequence.begin(), graph_sequence.end(), state);
+    }
+    return passing.size();
+  }));
+  for (int backend = 0; backend < kBackendCount; ++backend) {
+    state.backends.fill((MatchingBackend)backend);
+    for (const auto *tuples : {&failing, &passing}) {
+      string name = format("find_matching/{}/{}", backend_names[backend],
+                           tuples == &failing ? "failing" : "passing");
+      results.push_back(run_bench(name, [&] {
+        for (const auto &graph_sequence : *tuples) {
+          find_matching(graph_sequence, state);
         }
+        return tuples->size();
+      }));
+    }
+  }
+  results.push_back(run_bench("is_better/antichain", [&] {
+    PackedAntichain antichain(false);
+    for (const auto &seq : antichain_input) {
+      if (!antichain.covers(seq)) {
+        antichain.insert(seq);
+      }
+    }
+    return antichain_input.size();
+  }));
+
+  ofstream out(path);
+  out << format("{{\"s\": {}, \"benchmarks\": [", s);
+  for (const auto &[i, res] : results | views::enumerate) {
+    out << format("{}{{\"name\": \"{}\", \"iterations\": {}, \"items\": {}, "
+                  "\"ns_per_iteration\": {:.1f}, \"min_ns\": {:.1f}}}",
+                  i ? ", " : "", res.name, res.iterations, res.items,
+                  res.ns_per_iteration, res.min_ns);
+  }
+  out << "]}\n";
+}
+
+struct Options {
+  int thread_count = 0;
+  double progress_interval = 5;
+  string stats_path;
+  string trace_path;
+  string bench_path;
+  string witness_path;
+  string cache_path;
+  uint64_t cache_min_nodes = 100;
+  string state_path;
+  double budget_seconds = 0;
+  uint64_t max_tests = 0;
+  uint64_t samples = 0;
+  bool biased = true;
+  uint64_t seed = 1;
+  bool check = false;
+  bool count = false;
+  string spill_dir;
+  string matching;
+  bool validate = false;
+  bool chains = false;
+  int through = 0;
+  string results_dir = "results";
+};
+
+constexpr string_view kUsage =
+    "usage: 2_partite [THREADS] [--progress SECONDS] [--stats FILE]\n"
+    "                 [--bench FILE] [--check] [--witness FILE]\n"
+    "                 [--cache FILE] [--cache-min-nodes N] [--state FILE]\n"
+    "                 [--budget SECONDS] [--max-tests N] [--validate]\n"
+    "                 [--trace FILE] [--count] [--chains] [--spill DIR]\n"
+    "                 [--sample N] [--sampler biased|uniform] [--seed N]\n"
+    "                 [--matching dfs|dp|cover|greedy+dfs] [--through N]\n"
+    "                 [--results DIR]\n";
+
+// s is still read from stdin, so `echo 4 | ./2_partite` keeps working. With
+// --bench and --check the frontier of that s must follow it on stdin, e.g.
+// `./2_partite --check < results/4max.txt`. A search writes a witness for every
+// frontier row to the --witness file; --check reads them back from it, or
+// finds and writes them if the file does not exist yet. --cache keeps
+// matchability results of graph sequences that took more than N DFS nodes in
+// a file shared by all runs and by the drawer. Only --check, the witnesses a
+// search looks up for rows it did not keep one for, and the drawer consult
+// it; the search's own sweep decides whole buckets and never does. A file
+// written for another family is refused. A search stops after --budget
+// seconds or --max-tests exhaustive tests; it then writes the partial result
+// to the --state file, prints nothing but s and exits with status 2. A search
+// given an existing --state file continues from it. --sample N tests every
+// size sequence on N random graph sequences drawn by the biased (default) or
+// uniform --sampler; its output is a candidate frontier, to be confirmed by
+// --check with the --witness file it writes. --validate measures the
+// error rate of greedy_heuristic against the exact DFS on every multiset of s
+// graphs, and exits with status 1 when it misses any, as it does from s = 3.
+// --trace writes the start and end of every test and of every size sequence
+// a worker takes up, per worker, as Chrome trace-event JSON.
+// --count reads a frontier like --check and prints each row as
+// `sizes : tuples failing minimal`, its numbers of graph sequences, of those
+// without a rainbow matching and of the minimal ones among those (the ones
+// the drawer draws).
+// --chains searches only graph sequences that are chains G_1 <= G_2 <= ...
+// under containment. A size sequence that fails there fails, but the rows
+// printed need not be maximal among all graph sequences; confirm them with
+// --check.
+// --spill keeps the large sorted runs of the failing and passing antichains
+// in unlinked files in DIR instead of in RAM.
+// Single graph sequences in --check and --sample go to the matching backend
+// a short calibration at startup finds fastest for their edge density, the
+// witnesses written by a search to the DFS; --matching dfs|dp|cover|greedy+dfs
+// forces one. A backend that disagrees with the DFS during calibration is
+// reported and the run exits with status 1.
+// --through N searches every s from the one on stdin up to N in one process
+// and writes each frontier and its witnesses to <s>max.txt and <s>witness.txt
+// in the --results directory (results by default). The --cache file, if any,
+// is opened once and serves the witness lookups of every s. The frontier of
+// each s seeds the search for the next with rows known to fail and their
+// witnesses, see lift_frontier, so a seed row that stays on the frontier needs
+// no witness lookup. parse_options prints kUsage and returns nothing on an
+// unknown option, a missing value or a value that does not parse.
+optional<Options> parse_options(int argc, const char *argv[]) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    try {
+      if (arg == "--progress" && i + 1 < argc) {
+        options.progress_interval = stod(argv[++i]);
+      } else if (arg == "--stats" && i + 1 < argc) {
+        options.stats_path = argv[++i];
+      } else if (arg == "--trace" && i + 1 < argc) {
+        options.trace_path = argv[++i];
+      } else if (arg == "--bench" && i + 1 < argc) {
+        options.bench_path = argv[++i];
+      } else if (arg == "--witness" && i + 1 < argc) {
+        options.witness_path = argv[++i];
+      } else if (arg == "--cache" && i + 1 < argc) {
+        options.cache_path = argv[++i];
+      } else if (arg == "--cache-min-nodes" && i + 1 < argc) {
+        options.cache_min_nodes = stoull(argv[++i]);
+      } else if (arg == "--state" && i + 1 < argc) {
+        options.state_path = argv[++i];
+      } else if (arg == "--budget" && i + 1 < argc) {
+        options.budget_seconds = stod(argv[++i]);
+      } else if (arg == "--max-tests" && i + 1 < argc) {
+        options.max_tests = stoull(argv[++i]);
+      } else if (arg == "--sample" && i + 1 < argc) {
+        options.samples = stoull(argv[++i]);
+      } else if (arg == "--sampler" && i + 1 < argc) {
+        options.biased = string(argv[++i]) != "uniform";
+      } else if (arg == "--seed" && i + 1 < argc) {
+        options.seed = stoull(argv[++i]);
+      } else if (arg == "--check") {
+        options.check = true;
+      } else if (arg == "--count") {
+        options.count = true;
+      } else if (arg == "--spill" && i + 1 < argc) {
+        options.spill_dir = argv[++i];
+      } else if (arg == "--matching" && i + 1 < argc) {
+        options.matching = argv[++i];
+      } else if (arg == "--through" && i + 1 < argc) {
+        options.through = stoi(argv[++i]);
+      } else if (arg == "--results" && i + 1 < argc) {
+        options.results_dir = argv[++i];
+      } else if (arg == "--validate") {
+        options.validate = true;
+      } else if (arg == "--chains") {
+        options.chains = true;
+      } else if (!arg.empty() &&
+                 arg.find_first_not_of("0123456789") == string::npos) {
+        options.thread_count = stoi(arg);
+      } else {
+        cerr << "unknown option or missing value: " << arg << "\n" << kUsage;
+        return nullopt;
       }
-      for (const auto &tmp : to_remove) {
-        total.erase(tmp);
+    } catch (const logic_error &) {
+      cerr << "bad value for " << arg << ": " << argv[i] << "\n" << kUsage;
+      return nullopt;
+    }
+  }
+  return options;
+}
+
+// The backends --matching names, or else those calibration finds fastest for
+// --check and --sample, which test many single graph sequences. Anything else
+// tests a few (the witnesses of a search) and keeps the DFS. Nothing if a
+// backend disagrees with the DFS.
+optional<BackendChoice> choose_backends(const GraphCatalogue &catalogue,
+                                        const Options &options) {
+  BackendChoice res{};
+  if (!options.matching.empty()) {
+    res.fill((MatchingBackend)(ranges::find(backend_names, options.matching) -
+                               backend_names.begin()));
+  } else if (options.check || options.samples > 0) {
+    auto calibrated = calibrate_backends(catalogue, options.seed);
+    if (!calibrated) {
+      return nullopt;
+    }
+    res = *calibrated;
+    cerr << "matching backends by edge density:";
+    for (const auto &[regime, backend] : res | views::enumerate) {
+      cerr << format(" {}-{}% {}", 100 * regime / kRegimes,
+                     100 * (regime + 1) / kRegimes, backend_names[backend]);
+    }
+    cerr << "\n";
+  }
+  return res;
+}
+
+// The graph of `catalogue` with exactly these edges. The edges must form a
+// shifted graph of catalogue.s.
+GraphId find_graph(const GraphCatalogue &catalogue,
+                   const vector<pair<int, int>> &edges) {
+  auto bucket = catalogue.bucket(edges.size());
+  return *ranges::find_if(bucket, [&](GraphId graph) {
+    return ranges::all_of(edges, [&](pair<int, int> edge) {
+      return catalogue[graph].has_edge(edge.first, edge.second);
+    });
+  });
+}
+
+// Rows known to fail for s + 1 and their witnesses, from the frontier of s and
+// its witnesses in `from`, the catalogue of s. Shift the x vertices of every
+// graph of a graph sequence without a rainbow matching up by one, join the new
+// x = 1 to all s + 1 y vertices in each, and add the star at x = 1 as a new
+// colour. A perfect rainbow matching would have to give the star the only edge
+// at x = 1, leaving one of the old graphs on the old y vertices.
+map<vector<int>, GraphSequence>
+lift_frontier(const map<vector<int>, GraphSequence> &frontier,
+              const GraphCatalogue &from, const GraphCatalogue &to) {
+  int star = from.s + 1;
+  vector<pair<int, int>> star_edges;
+  for (int y = 1; y <= star; ++y) {
+    star_edges.emplace_back(1, y);
+  }
+  GraphId star_graph = find_graph(to, star_edges);
+  map<vector<int>, GraphSequence> res;
+  for (const auto &[row, witness] : frontier) {
+    vector<int> lifted;
+    for (int size : row) {
+      lifted.push_back(size + star);
+    }
+    lifted.push_back(star);
+    GraphSequence lifted_witness;
+    lifted_witness.push_back(star_graph);
+    for (GraphId graph : witness) {
+      auto edges = star_edges;
+      for (auto [x, y] : from[graph].edges()) {
+        edges.emplace_back(x + 1, y);
       }
-      total.insert(seq);
+      lifted_witness.push_back(find_graph(to, edges));
+    }
+    res.emplace(move(lifted), lifted_witness);
+  }
+  return res;
+}
+
+// The search for the frontier of catalogue.s, written to `out` as s and then
+// one row per line, with the witnesses to witness_path and to `frontier` if it
+// is set. The `seed` rows are known to fail, with their witnesses. A witness
+// the search did not keep is looked up through the certificate cache if there
+// is one. Returns the exit status, 2 if the budget ran out.
+int search(const GraphCatalogue &catalogue, const Options &options,
+           const BackendChoice &backends, CertificateCache *cache,
+           const map<vector<int>, GraphSequence> &seed, ostream &out,
+           const string &witness_path,
+           map<vector<int>, GraphSequence> &frontier) {
+  int s = catalogue.s;
+  out << s << endl;
+  SizeSequenceRanking ranking(s, catalogue.max_size());
+  Boundary<GraphSequence> boundary(options.spill_dir);
+  for (const auto &[row, witness] : seed) {
+    boundary.insert(row, true, &witness);
+  }
+  if (!options.state_path.empty()) {
+    ifstream in(options.state_path);
+    if (in && !read_state(in, ranking, boundary)) {
+      return 1;
     }
   }
-  for (const auto &seq : total) {
+  Budget budget;
+  if (options.budget_seconds > 0) {
+    budget.deadline =
+        chrono::steady_clock::now() +
+        chrono::duration_cast<chrono::steady_clock::duration>(
+            chrono::duration<double>(options.budget_seconds));
+  }
+  if (options.max_tests > 0) {
+    budget.max_tests = options.max_tests;
+  }
+  vector<BucketCaps> caps_by_size;
+  for (int size = 0; size <= catalogue.max_size(); ++size) {
+    caps_by_size.emplace_back(catalogue, size);
+  }
+  optional<ContainmentLattice> lattice;
+  if (options.chains) {
+    lattice.emplace(catalogue);
+  }
+  int thread_count = (options.thread_count == 0
+                          ? (int)min<uint64_t>(thread::hardware_concurrency(),
+                                               ranking.size())
+                          : options.thread_count);
+  vector<SearchStats> stats(thread_count);
+  for (auto &st : stats) {
+    st.tracing = !options.trace_path.empty();
+  }
+  auto start = chrono::steady_clock::now();
+  {
+    jthread reporter;
+    if (STATS && options.progress_interval > 0) {
+      reporter = jthread(report_progress, options.progress_interval,
+                         ranking.size(), cref(stats));
+    }
+    vector<jthread> threads;
+    for (int i = 0; i < thread_count; ++i) {
+      threads.emplace_back([i, thread_count, &ranking, &catalogue,
+                            &caps_by_size, &lattice, &boundary, &budget,
+                            &stats, &options, &backends] {
+        optional<TupleSampler> sampler;
+        if (options.samples > 0) {
+          sampler.emplace(catalogue, options.samples, options.biased,
+                          options.seed + i, backends);
+        }
+        // With a sampler the test is the sampler's, with a lattice it tries
+        // only chains.
+        auto fails = [&](const vector<int> &size_sequence,
+                         optional<GraphSequence> &witness) {
+          if (sampler) {
+            return sampler->fails(size_sequence, stats[i], witness.emplace());
+          }
+          return sweep_fails(size_sequence, catalogue, caps_by_size, stats[i],
+                             lattice ? &*lattice : nullptr);
+        };
+        do_stuff(views::iota(uint64_t{0}, ranking.size()) | views::reverse |
+                     views::drop(i) | views::stride(thread_count) |
+                     views::transform([&ranking](uint64_t rank) {
+                       return ranking.unrank(rank);
+                     }),
+                 catalogue.max_size(), boundary, budget, stats[i], fails);
+      });
+    }
+    for (auto &thrd : threads) {
+      thrd.join();
+    }
+  }
+  if (STATS && !options.stats_path.empty()) {
+    write_stats_json(
+        options.stats_path, s,
+        chrono::duration<double>(chrono::steady_clock::now() - start).count(),
+        stats);
+  }
+  if (!options.trace_path.empty()) {
+    write_trace_json(options.trace_path, start, stats);
+  }
+  if (!options.state_path.empty()) {
+    ofstream out(options.state_path);
+    write_state(out, s, catalogue.max_size(), boundary, ranking);
+  }
+  if (budget.exhausted) {
+    cerr << "budget exhausted\n";
+    return 2;
+  }
+  if (options.samples > 0) {
+    cerr << "sampled: the frontier is a candidate, confirm it with --check\n";
+  }
+  if (options.chains) {
+    cerr << "chains: the rows fail but may not be maximal, confirm them with "
+            "--check\n";
+  }
+  auto rows = boundary.failing.rows();
+  for (const auto &seq : rows) {
     for (const auto &x : seq) {
-      cout << x << " ";
+      out << x << " ";
+    }
+    out << endl;
+  }
+  if (!witness_path.empty()) {
+    ofstream witnesses(witness_path);
+    if (!witnesses) {
+      cerr << "cannot write " << witness_path << "\n";
+      return 1;
+    }
+    MatchingState state(catalogue);
+    state.backends = backends;
+    for (const auto &seq : rows) {
+      auto it = boundary.witnesses.find(seq);
+      auto witness = it != boundary.witnesses.end()
+                         ? it->second
+                         : *find_witness(seq, catalogue, state, cache);
+      write_witness(witnesses, catalogue, seq, witness);
+      frontier.emplace(seq, witness);
+    }
+  }
+  return 0;
+}
+
+int main(int argc, const char *argv[]) {
+  auto parsed = parse_options(argc, argv);
+  if (!parsed) {
+    return 1;
+  }
+  const auto &options = *parsed;
+  int s;
+  cin >> s;
+  GraphCatalogue catalogue(s);
+  if (!options.bench_path.empty()) {
+    auto frontier = read_size_sequences(cin);
+    if (frontier.empty()) {
+      cerr << "--bench needs the frontier of s on stdin\n";
+      return 1;
+    }
+    run_benchmarks(catalogue, frontier, options.bench_path);
+    return 0;
+  }
+  unique_ptr<CertificateCache> cache;
+  if (!options.cache_path.empty()) {
+    try {
+      cache = make_unique<CertificateCache>(options.cache_path, kCacheFamily);
+    } catch (const runtime_error &error) {
+      cerr << error.what() << "\n";
+      return 1;
+    }
+    cache->min_nodes = options.cache_min_nodes;
+  }
+  if (!options.matching.empty() &&
+      ranges::find(backend_names, options.matching) == backend_names.end()) {
+    cerr << "unknown --matching backend " << options.matching << "\n";
+    return 1;
+  }
+  auto chosen = choose_backends(catalogue, options);
+  if (!chosen) {
+    return 1;
+  }
+  BackendChoice backends = *chosen;
+  if (options.check) {
+    auto frontier = read_size_sequences(cin);
+    int thread_count = (options.thread_count == 0
+                            ? (int)thread::hardware_concurrency()
+                            : options.thread_count);
+    return check_frontier<GraphSequence>(
+               catalogue, frontier, options.witness_path, thread_count,
+               [&] { return WitnessWorker(catalogue, cache.get(), backends); })
+               ? 0
+               : 1;
+  }
+  if (options.count) {
+    auto frontier = read_size_sequences(cin);
+    int thread_count = (options.thread_count == 0
+                            ? (int)thread::hardware_concurrency()
+                            : options.thread_count);
+    vector<BucketCaps> caps_by_size;
+    for (int size = 0; size <= catalogue.max_size(); ++size) {
+      caps_by_size.emplace_back(catalogue, size);
+    }
+    auto count_row = [&](const vector<int> &row, GraphId first) {
+      return count_failures(row, first, catalogue, caps_by_size);
+    };
+    return count_frontier(catalogue, frontier, thread_count, count_row) ? 0
+                                                                        : 1;
+  }
+  if (options.validate) {
+    int thread_count = (options.thread_count == 0
+                            ? (int)thread::hardware_concurrency()
+                            : options.thread_count);
+    return validate_greedy(catalogue, thread_count) ? 0 : 1;
+  }
+  if (options.samples > 0 && !options.state_path.empty()) {
+    cerr << "--sample cannot be combined with --state\n";
+    return 1;
+  }
+  if (options.chains &&
+      (options.samples > 0 || !options.state_path.empty())) {
+    cerr << "--chains cannot be combined with --sample or --state\n";
+    return 1;
+  }
+  if (options.through > 0 &&
+      (!options.state_path.empty() || !options.stats_path.empty() ||
+       !options.trace_path.empty() || !options.witness_path.empty())) {
+    cerr << "--through cannot be combined with --state, --stats, --trace or "
+            "--witness\n";
+    return 1;
+  }
+  if (options.through > 0 && options.through < s) {
+    cerr << "--through " << options.through << " is below s = " << s << "\n";
+    return 1;
+  }
+  map<vector<int>, GraphSequence> frontier;
+  if (options.through == 0) {
+    return search(catalogue, options, backends, cache.get(), {}, cout,
+                  options.witness_path, frontier);
+  }
+  for (int t = s; t <= options.through; ++t) {
+    map<vector<int>, GraphSequence> seed;
+    if (t > s) {
+      GraphCatalogue next(t);
+      seed = lift_frontier(frontier, catalogue, next);
+      frontier.clear();
+      catalogue = move(next);
+      chosen = choose_backends(catalogue, options);
+      if (!chosen) {
+        return 1;
+      }
+      backends = *chosen;
+    }
+    string path = format("{}/{}max.txt", options.results_dir, t);
+    ofstream out(path);
+    if (!out) {
+      cerr << "cannot write " << path << "\n";
+      return 1;
+    }
+    string witness_path = format("{}/{}witness.txt", options.results_dir, t);
+    if (int status = search(catalogue, options, backends, cache.get(), seed,
+                            out, witness_path, frontier)) {
+      return status;
     }
-    cout << endl;
+    cerr << format("s = {}: {} frontier rows, {} seeded from s = {}\n", t,
+                   frontier.size(), seed.size(), t - 1);
   }
+  return 0;
 }
@@ -0,0 +1,995 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <generator>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <shared_mutex>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../common/boundary.h"
+#include "../common/frontier.h"
+#include "../common/packed_antichain.h"
+#include "../common/search_stats.h"
+#include "../common/size_sequences.h"
+
+using namespace std;
+
+// A shifted 3-partite 3-uniform hypergraph on the parts X, Y, Z = {1..s} is a
+// down-set of [s]^3. It is stored as its staircase: (x, y, z) is an edge iff
+// z <= height(x, y), and the heights do not grow along x or y. The heights
+// are packed four bits per cell, row by row, into 64 bits, which bounds s:
+// kMaxS is the largest s whose s * s cells fit.
+constexpr int kMaxS = [] {
+  int s = 1;
+  while ((s + 1) * (s + 1) * 4 <= 64) {
+    ++s;
+  }
+  return s;
+}();
+// A vertex set of the matching DFS is a 16-bit mask over the 3s vertices.
+static_assert(3 * kMaxS <= 16);
+
+// The permutations of the parts (X, Y, Z). Applied to all graphs of a graph
+// sequence at once, each maps it to one with the same matchings.
+constexpr array<array<int, 3>, 6> kPartPermutations = {
+    {{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}}};
+
+struct ShiftedGraph {
+  int s;
+  uint64_t heights;
+
+  int height(int x, int y) const {
+    return heights >> (4 * ((x - 1) * s + y - 1)) & 15;
+  }
+
+  bool has_edge(int x, int y, int z) const {
+    return 1 <= x && x <= s && 1 <= y && y <= s && 1 <= z &&
+           z <= height(x, y);
+  }
+
+  int edge_count() const {
+    int res = 0;
+    for (int cell = 0; cell < s * s; ++cell) {
+      res += heights >> (4 * cell) & 15;
+    }
+    return res;
+  }
+
+  // The maximal edges of the down-set.
+  int corner_count() const {
+    int res = 0;
+    for (int x = 1; x <= s; ++x) {
+      for (int y = 1; y <= s; ++y) {
+        int h = height(x, y);
+        res += h > 0 && (x == s || height(x + 1, y) < h) &&
+               (y == s || height(x, y + 1) < h);
+      }
+    }
+    return res;
+  }
+
+  // The graph whose part i is part perm[i] of this one.
+  ShiftedGraph permuted(const array<int, 3> &perm) const {
+    uint64_t res = 0;
+    for (int a = 1; a <= s; ++a) {
+      for (int b = 1; b <= s; ++b) {
+        int h = 0;
+        for (int c = 1; c <= s; ++c) {
+          array<int, 3> point;
+          point[perm[0]] = a;
+          point[perm[1]] = b;
+          point[perm[2]] = c;
+          if (has_edge(point[0], point[1], point[2])) {
+            h = c;
+          }
+        }
+        res |= (uint64_t)h << (4 * ((a - 1) * s + b - 1));
+      }
+    }
+    return {s, res};
+  }
+};
+
+// Staircases of the s x s x s box, cell by cell in row-major order: a height
+// is at most those of the cells before it in its row and in its column.
+generator<uint64_t> gen_graphs(int s, int cell, uint64_t heights) {
+  if (cell == s * s) {
+    co_yield heights;
+  } else {
+    int max_h = s;
+    if (cell >= s) {
+      max_h = min<int>(max_h, heights >> (4 * (cell - s)) & 15);
+    }
+    if (cell % s > 0) {
+      max_h = min<int>(max_h, heights >> (4 * (cell - 1)) & 15);
+    }
+    for (int h = 0; h <= max_h; ++h) {
+      for (uint64_t graph :
+           gen_graphs(s, cell + 1, heights | (uint64_t)h << (4 * cell))) {
+        co_yield graph;
+      }
+    }
+  }
+}
+
+// A vertex set is a bitmask over the 3s vertices: x is bit x - 1, y is bit
+// s + y - 1 and z is bit 2s + z - 1. An edge is the mask of its vertices.
+uint16_t edge_bits(int s, int x, int y, int z) {
+  return 1u << (x - 1) | 1u << (s + y - 1) | 1u << (2 * s + z - 1);
+}
+
+using GraphId = uint32_t;
+
+// All shifted hypergraphs of one s, grouped by edge count: the graphs with
+// `size` edges are the ids [bucket_begin[size], bucket_begin[size + 1]). The
+// edges of graph `id`, as vertex masks in lexicographic order, are
+// edge_masks[edge_begin[id], edge_begin[id + 1]).
+//
+// Every bucket lists first the graphs that do not come after any of their
+// images under kPartPermutations in generation order, up to
+// canonical_end[size].
+struct GraphCatalogue {
+  int s;
+  vector<GraphId> bucket_begin;
+  vector<GraphId> canonical_end;
+  vector<uint64_t> staircases;
+  vector<uint32_t> edge_begin;
+  vector<uint16_t> edge_masks;
+
+  explicit GraphCatalogue(int s) : s(s) {
+    if (s < 1 || s > kMaxS) {
+      throw runtime_error(format("s must be between 1 and {}", kMaxS));
+    }
+    vector<vector<uint64_t>> by_size(s * s * s + 1);
+    for (uint64_t heights : gen_graphs(s, 0, 0)) {
+      by_size[ShiftedGraph{s, heights}.edge_count()].push_back(heights);
+    }
+    bucket_begin.push_back(0);
+    edge_begin.push_back(0);
+    for (auto &bucket : by_size) {
+      unordered_map<uint64_t, int> index;
+      for (const auto &[i, heights] : bucket | views::enumerate) {
+        index.emplace(heights, i);
+      }
+      vector<uint64_t> ordered, rest;
+      for (const auto &[i, heights] : bucket | views::enumerate) {
+        ShiftedGraph graph{s, heights};
+        bool canonical =
+            ranges::all_of(kPartPermutations, [&](const auto &perm) {
+              return i <= index.at(graph.permuted(perm).heights);
+            });
+        (canonical ? ordered : rest).push_back(heights);
+      }
+      int canonical = ordered.size();
+      ranges::copy(rest, back_inserter(ordered));
+      for (uint64_t heights : ordered) {
+        ShiftedGraph graph{s, heights};
+        staircases.push_back(heights);
+        for (int x = 1; x <= s; ++x) {
+          for (int y = 1; y <= s; ++y) {
+            for (int z = 1; z <= graph.height(x, y); ++z) {
+              edge_masks.push_back(edge_bits(s, x, y, z));
+            }
+          }
+        }
+        edge_begin.push_back(edge_masks.size());
+      }
+      canonical_end.push_back(bucket_begin.back() + canonical);
+      bucket_begin.push_back(staircases.size());
+    }
+  }
+
+  int max_size() const { return bucket_begin.size() - 2; }
+
+  int bucket_size(int size) const {
+    return bucket_begin[size + 1] - bucket_begin[size];
+  }
+
+  int canonical_size(int size) const {
+    return canonical_end[size] - bucket_begin[size];
+  }
+
+  auto bucket(int size) const {
+    return views::iota(bucket_begin[size], bucket_begin[size + 1]);
+  }
+
+  ShiftedGraph operator[](GraphId id) const { return {s, staircases[id]}; }
+
+  span<const uint16_t> edges(GraphId id) const {
+    return span(edge_masks).subspan(edge_begin[id],
+                                    edge_begin[id + 1] - edge_begin[id]);
+  }
+};
+
+// The graphs of a graph sequence, one id per colour, stored inline.
+struct GraphSequence {
+  array<GraphId, kMaxS> ids;
+  int length = 0;
+
+  const GraphId *begin() const { return ids.data(); }
+  const GraphId *end() const { return ids.data() + length; }
+  int size() const { return length; }
+  bool empty() const { return length == 0; }
+  GraphId operator[](int i) const { return ids[i]; }
+  GraphId &operator[](int i) { return ids[i]; }
+  GraphId front() const { return ids[0]; }
+  GraphId back() const { return ids[length - 1]; }
+  void push_back(GraphId id) { ids[length++] = id; }
+  void pop_back() { --length; }
+};
+
+// The DFS state of gen_matching. The vertices used so far determine the
+// colour being matched (a third of their number), so one bit per vertex mask
+// remembers every state that has already failed for the current graph
+// sequence.
+struct MatchingState {
+  const GraphCatalogue &catalogue;
+  vector<uint64_t> failed;
+  // One edge mask per matched colour.
+  vector<uint16_t> matching;
+  uint64_t nodes = 0;
+
+  explicit MatchingState(const GraphCatalogue &catalogue)
+      : catalogue(catalogue),
+        failed(max(1, (1 << (3 * catalogue.s)) / 64)) {}
+
+  void reset() {
+    ranges::fill(failed, 0);
+    matching.clear();
+  }
+};
+
+bool match_colours(const GraphId *graphs, int colour, int colours,
+                   uint32_t used, MatchingState &state) {
+  if (colour == colours) {
+    return true;
+  }
+  if (state.failed[used / 64] >> (used % 64) & 1) {
+    return false;
+  }
+  ++state.nodes;
+  for (uint16_t edge : state.catalogue.edges(graphs[colour])) {
+    if (edge & used) {
+      continue;
+    }
+    state.matching.push_back(edge);
+    if (match_colours(graphs, colour + 1, colours, used | edge, state)) {
+      return true;
+    }
+    state.matching.pop_back();
+  }
+  state.failed[used / 64] |= 1ull << (used % 64);
+  return false;
+}
+
+// A rainbow matching of the graph sequence from a reset state.
+bool gen_matching(const GraphId *graphs_begin, const GraphId *graphs_end,
+                  MatchingState &state) {
+  return match_colours(graphs_begin, 0, graphs_end - graphs_begin, 0, state);
+}
+
+// The colour of a graph sequence of these sizes whose restriction to
+// canonical graphs leaves the smallest fraction of its bucket, or -1. Every
+// graph sequence has an image under kPartPermutations with a canonical graph
+// there, so only those need a test.
+int canonical_colour(const vector<int> &size_sequence,
+                     const GraphCatalogue &catalogue) {
+  int res = -1;
+  double best = 1;
+  for (const auto &[c, size] :
+       size_sequence | views::reverse | views::enumerate) {
+    double kept = (double)catalogue.canonical_size(size) /
+                  max(1, catalogue.bucket_size(size));
+    if (kept < best) {
+      best = kept;
+      res = c;
+    }
+  }
+  return res;
+}
+
+// Vertex sets covered by rainbow matchings of a prefix of a graph sequence:
+// layers[k] is a bitset over all vertex masks reachable after colours 0..k.
+// The sweep chooses the colours depth-first, so recompute only redoes the
+// layers from the colour it chose.
+//
+// A shifted hypergraph has an edge avoiding a vertex set U iff it contains
+// (fx, fy, fz), the smallest free vertex of every part, that is iff
+// height(fx, fy) >= fz. So all that matters about a prefix for its last
+// colour is need[fx][fy], the smallest fz over the prefix's matchings.
+struct PrefixMatchings {
+  const GraphCatalogue &catalogue;
+  int s;
+  int words;
+  vector<vector<uint64_t>> layers;
+
+  PrefixMatchings(const GraphCatalogue &catalogue, int colours)
+      : catalogue(catalogue), s(catalogue.s),
+        words(max(1, (1 << (3 * s)) / 64)),
+        layers(colours, vector<uint64_t>(words)) {}
+
+  static inline const vector<uint64_t> empty_set = {1};
+
+  // The vertex sets of the matchings of the colours behind `prev` extended
+  // by an edge of `graph`.
+  void extend(const vector<uint64_t> &prev, GraphId graph,
+              vector<uint64_t> &layer) const {
+    layer.assign(words, 0);
+    auto edges = catalogue.edges(graph);
+    for (int word = 0; word < prev.size(); ++word) {
+      for (uint64_t bits = prev[word]; bits; bits &= bits - 1) {
+        uint32_t used = word * 64 + countr_zero(bits);
+        for (uint16_t edge : edges) {
+          if (!(edge & used)) {
+            uint32_t next = used | edge;
+            layer[next / 64] |= 1ull << (next % 64);
+          }
+        }
+      }
+    }
+  }
+
+  void recompute(const GraphSequence &prefix, int from) {
+    for (int k = from; k < prefix.size(); ++k) {
+      extend(k == 0 ? empty_set : layers[k - 1], prefix[k], layers[k]);
+    }
+  }
+
+  // The smallest free vertex of every part.
+  array<int, 3> first_free(uint32_t used) const {
+    return {countr_one(used) + 1, countr_one(used >> s) + 1,
+            countr_one(used >> (2 * s)) + 1};
+  }
+
+  // Most edges a shifted hypergraph can have without the edge (fx, fy, fz).
+  int blocked(int fx, int fy, int fz) const {
+    return s * s * s - (s - fx + 1) * (s - fy + 1) * (s - fz + 1);
+  }
+
+  // Whether some matching of colours 0..k extends to all later colours by
+  // taking the edge (fx, fy, fz) of each, which every graph of more than
+  // blocked(fx, fy, fz) edges has.
+  bool completes_any(const vector<uint64_t> &layer, int k,
+                     const vector<int> &sizes) const {
+    for (int word = 0; word < layer.size(); ++word) {
+      for (uint64_t bits = layer[word]; bits; bits &= bits - 1) {
+        uint32_t used = word * 64 + countr_zero(bits);
+        bool completes = true;
+        for (int t = k + 1; t < sizes.size() && completes; ++t) {
+          auto [fx, fy, fz] = first_free(used);
+          completes = sizes[t] > blocked(fx, fy, fz);
+          used |= edge_bits(s, fx, fy, fz);
+        }
+        if (completes) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  // need[fx * (s + 1) + fy] for a prefix with the matchings `layer`, 0xff
+  // where none leaves that pair free first.
+  void required_heights(const vector<uint64_t> &layer,
+                        vector<uint8_t> &need) const {
+    need.assign((s + 1) * (s + 1), 0xff);
+    for (int word = 0; word < layer.size(); ++word) {
+      for (uint64_t bits = layer[word]; bits; bits &= bits - 1) {
+        auto [fx, fy, fz] = first_free(word * 64 + countr_zero(bits));
+        need[fx * (s + 1) + fy] = min<int>(need[fx * (s + 1) + fy], fz);
+      }
+    }
+  }
+
+  bool completes(const ShiftedGraph &graph, const vector<uint8_t> &need) const {
+    for (int x = 1; x <= s; ++x) {
+      for (int y = 1; y <= s; ++y) {
+        if (graph.height(x, y) >= need[x * (s + 1) + y]) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+};
+
+// Decides a size sequence by a depth-first walk over the graphs of all colours
+// but the last one, growing the prefix matchings a colour at a time, and a
+// sweep of the last bucket against the need table. A prefix without a rainbow
+// matching fails with every completion, and one with a matching that the
+// sizes of the later colours alone let extend greedily passes with every
+// completion; neither subtree is walked. Returns whether some graph sequence
+// has no rainbow matching, and leaves one in `witness` if it is given.
+bool sweep_fails(const vector<int> &size_sequence,
+                 const GraphCatalogue &catalogue, SearchStats &stats,
+                 GraphSequence *witness = nullptr) {
+  vector<int> sizes(size_sequence.rbegin(), size_sequence.rend());
+  int colours = sizes.size();
+  for (int size : sizes) {
+    if (catalogue.bucket_size(size) == 0) {
+      return false;
+    }
+  }
+  int canonical = canonical_colour(
+      vector<int>(size_sequence.begin() + 1, size_sequence.end()), catalogue);
+  PrefixMatchings prefix_matchings(catalogue, colours - 1);
+  GraphSequence prefix;
+  vector<uint8_t> need;
+  // Leaves a failing prefix in `prefix`.
+  auto fails = [&](auto &&fails, int k) -> bool {
+    if (k == colours - 1) {
+      prefix_matchings.required_heights(
+          k == 0 ? PrefixMatchings::empty_set : prefix_matchings.layers[k - 1],
+          need);
+      stats.bump(kBucketSweeps);
+      stats.bump(kGraphSequences, catalogue.bucket_size(sizes[k]));
+      for (GraphId graph : catalogue.bucket(sizes[k])) {
+        if (!prefix_matchings.completes(catalogue[graph], need)) {
+          prefix.push_back(graph);
+          return true;
+        }
+      }
+      return false;
+    }
+    int end = catalogue.bucket_begin[sizes[k]] +
+              (k == canonical ? catalogue.canonical_size(sizes[k])
+                              : catalogue.bucket_size(sizes[k]));
+    for (GraphId graph = catalogue.bucket_begin[sizes[k]]; graph < end;
+         ++graph) {
+      prefix.push_back(graph);
+      prefix_matchings.recompute(prefix, k);
+      if (ranges::all_of(prefix_matchings.layers[k],
+                         [](uint64_t word) { return word == 0; })) {
+        return true;
+      }
+      if (prefix_matchings.completes_any(prefix_matchings.layers[k], k,
+                                                 sizes)) {
+        stats.bump(kPrefixPrunes);
+      } else if (fails(fails, k + 1)) {
+        return true;
+      }
+      prefix.pop_back();
+    }
+    return false;
+  };
+  if (!fails(fails, 0)) {
+    return false;
+  }
+  if (witness != nullptr) {
+    *witness = prefix;
+    for (int t = prefix.size(); t < colours; ++t) {
+      witness->push_back(catalogue.bucket_begin[sizes[t]]);
+    }
+  }
+  return true;
+}
+
+// Counts the graph sequences of a size sequence that start with `first`: all
+// of them, those without a rainbow matching and the minimal ones among those,
+// which have a matching once any one colour is left out. Sequences with a
+// common prefix share its layers, and next to them the walk keeps the layers
+// of the prefix without each one of its colours. The last colour is counted a
+// bucket at a time, and a prefix without a matching, or with one that surely
+// extends, settles all its completions at once.
+FailureCounts count_failures(const vector<int> &size_sequence, GraphId first,
+                             const GraphCatalogue &catalogue) {
+  vector<int> sizes(size_sequence.rbegin(), size_sequence.rend());
+  int colours = sizes.size();
+  // completions[k]: the number of graph sequences of colours k..
+  vector<uint64_t> completions(colours + 1, 1);
+  for (int k = colours - 1; k >= 0; --k) {
+    completions[k] = completions[k + 1] * catalogue.bucket_size(sizes[k]);
+  }
+  int last_size = catalogue.bucket_size(sizes.back());
+  PrefixMatchings prefix_matchings(catalogue, 0);
+  vector<uint8_t> need;
+  auto mark_completions = [&](const vector<uint64_t> &layer,
+                              vector<char> &completes) {
+    prefix_matchings.required_heights(layer, need);
+    completes.clear();
+    for (GraphId graph : catalogue.bucket(sizes.back())) {
+      completes.push_back(prefix_matchings.completes(catalogue[graph], need));
+    }
+  };
+  // layers[k] holds the matchings of colours 0..k-1, without[k][i] those of
+  // the same colours but i.
+  vector<vector<uint64_t>> layers(colours, PrefixMatchings::empty_set);
+  vector<vector<vector<uint64_t>>> without(colours,
+                                           vector<vector<uint64_t>>(colours));
+  auto empty = [](const vector<uint64_t> &layer) {
+    return ranges::all_of(layer, [](uint64_t word) { return word == 0; });
+  };
+  vector<char> completes, completes_without, minimal;
+  FailureCounts res;
+  // `maybe_minimal` is false once the prefix without one of its colours
+  // already has no matching.
+  auto count = [&](auto &&count, int k, bool maybe_minimal) -> void {
+    if (k == colours - 1) {
+      res.tuples += last_size;
+      mark_completions(layers[k], completes);
+      minimal.assign(last_size, maybe_minimal && !empty(layers[k]));
+      for (int i = 0; i < k && maybe_minimal; ++i) {
+        mark_completions(without[k][i], completes_without);
+        for (int g = 0; g < last_size; ++g) {
+          minimal[g] = minimal[g] && completes_without[g];
+        }
+      }
+      for (int g = 0; g < last_size; ++g) {
+        if (!completes[g]) {
+          ++res.failing;
+          res.minimal += minimal[g];
+        }
+      }
+      return;
+    }
+    int begin = (k == 0 ? first : catalogue.bucket_begin[sizes[k]]);
+    int end = (k == 0 ? first + 1 : catalogue.bucket_begin[sizes[k] + 1]);
+    for (int graph = begin; graph < end; ++graph) {
+      prefix_matchings.extend(layers[k], graph, layers[k + 1]);
+      if (empty(layers[k + 1])) {
+        res.tuples += completions[k + 1];
+        res.failing += completions[k + 1];
+        continue;
+      }
+      if (prefix_matchings.completes_any(layers[k + 1], k, sizes)) {
+        res.tuples += completions[k + 1];
+        continue;
+      }
+      bool still_minimal = maybe_minimal;
+      for (int i = 0; i < k && still_minimal; ++i) {
+        prefix_matchings.extend(without[k][i], graph, without[k + 1][i]);
+        still_minimal = !empty(without[k + 1][i]);
+      }
+      without[k + 1][k] = layers[k];
+      count(count, k + 1, still_minimal);
+    }
+  };
+  count(count, 0, true);
+  return res;
+}
+
+// Tests size sequences on random graph sequences instead of all of them, for
+// s beyond exhaustive reach (s = 4 has 232848 staircases): a failure comes
+// with its witness, a pass is only a guess. The uniform sampler draws every
+// graph of a bucket alike. The biased one favours staircases with few
+// corners and repeats the previous colour's graph for an equal size with
+// probability 1/2. One sampler per worker.
+struct TupleSampler {
+  const GraphCatalogue &catalogue;
+  uint64_t samples;
+  bool biased;
+  mt19937_64 rng;
+  vector<discrete_distribution<int>> by_size;
+  MatchingState state;
+
+  TupleSampler(const GraphCatalogue &catalogue, uint64_t samples, bool biased,
+               uint64_t seed)
+      : catalogue(catalogue), samples(samples), biased(biased), rng(seed),
+        state(catalogue) {
+    for (int size = 0; size <= catalogue.max_size(); ++size) {
+      vector<double> weights;
+      for (GraphId graph : catalogue.bucket(size)) {
+        int corners = catalogue[graph].corner_count();
+        weights.push_back(biased ? ldexp(1.0, -corners) : 1.0);
+      }
+      by_size.emplace_back(weights.begin(), weights.end());
+    }
+  }
+
+  void draw(const vector<int> &size_sequence, GraphSequence &graph_sequence) {
+    graph_sequence = {};
+    int last_size = -1;
+    for (int size : size_sequence | views::reverse) {
+      if (biased && size == last_size && rng() % 2) {
+        graph_sequence.push_back(graph_sequence.back());
+      } else {
+        graph_sequence.push_back(catalogue.bucket_begin[size] +
+                                 by_size[size](rng));
+      }
+      last_size = size;
+    }
+  }
+
+  // Whether one of `samples` random graph sequences has no rainbow matching,
+  // which is then left in `witness`.
+  bool fails(const vector<int> &size_sequence, SearchStats &stats,
+             GraphSequence &witness) {
+    for (int size : size_sequence) {
+      if (catalogue.bucket_size(size) == 0) {
+        return false;
+      }
+    }
+    for (uint64_t i = 0; i < samples; ++i) {
+      draw(size_sequence, witness);
+      stats.bump(kGraphSequences);
+      state.reset();
+      bool matched = gen_matching(witness.begin(), witness.end(), state);
+      stats.bump(kMatchingNodes, state.nodes);
+      state.nodes = 0;
+      if (!matched) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+// A graph sequence of the given sizes without a rainbow matching.
+optional<GraphSequence> find_witness(const vector<int> &size_sequence,
+                                     const GraphCatalogue &catalogue) {
+  SearchStats stats;
+  GraphSequence witness;
+  if (sweep_fails(size_sequence, catalogue, stats, &witness)) {
+    return witness;
+  }
+  return nullopt;
+}
+
+// One line per frontier row: the sizes, then the staircase of every graph of
+// the witness in the same order, one comma-separated row of heights per x,
+// e.g. `3 1 : 2,1 0,0 | 1,0 0,0` for s = 2.
+void write_witness(ostream &out, const GraphCatalogue &catalogue,
+                   const vector<int> &size_sequence,
+                   const GraphSequence &witness) {
+  int s = catalogue.s;
+  for (int size : size_sequence) {
+    out << size << " ";
+  }
+  out << ":";
+  for (const auto &[i, graph] : witness | views::reverse | views::enumerate) {
+    out << (i ? " |" : "");
+    for (int x = 1; x <= s; ++x) {
+      for (int y = 1; y <= s; ++y) {
+        out << (y == 1 ? " " : ",") << catalogue[graph].height(x, y);
+      }
+    }
+  }
+  out << "\n";
+}
+
+// Lines that cannot be parsed or name graphs outside the catalogue are
+// reported, counted in `rejected` and skipped.
+map<vector<int>, GraphSequence>
+read_witnesses(istream &in, const GraphCatalogue &catalogue, int &rejected) {
+  int s = catalogue.s;
+  map<vector<int>, GraphSequence> res;
+  string line;
+  while (getline(in, line)) {
+    auto colon = line.find(':');
+    if (colon == string::npos) {
+      continue;
+    }
+    vector<int> size_sequence;
+    {
+      istringstream ss(line.substr(0, colon));
+      int n;
+      while (ss >> n) {
+        size_sequence.push_back(n);
+      }
+    }
+    // One packed staircase per graph, 0xff.. once a row is malformed.
+    constexpr uint64_t kMalformed = ~0ull;
+    vector<uint64_t> staircases(1);
+    vector<int> rows(1);
+    {
+      istringstream ss(line.substr(colon + 1));
+      string token;
+      while (ss >> token) {
+        if (token == "|") {
+          staircases.emplace_back();
+          rows.emplace_back();
+          continue;
+        }
+        istringstream row(token);
+        string cell;
+        int y = 0;
+        while (getline(row, cell, ',')) {
+          int h = stoi(cell);
+          if (rows.back() >= s || y >= s || h < 0 || h > s) {
+            staircases.back() = kMalformed;
+            break;
+          }
+          staircases.back() |= (uint64_t)h << (4 * (rows.back() * s + y++));
+        }
+        ++rows.back();
+      }
+    }
+    if (staircases.size() != size_sequence.size()) {
+      cerr << "malformed witness: " << line << "\n";
+      ++rejected;
+      continue;
+    }
+    // Witness graphs are looked up in the catalogue, so a witness naming a
+    // staircase that is not shifted or has the wrong size is rejected here.
+    GraphSequence witness;
+    for (auto [size, heights] :
+         views::zip(size_sequence, staircases) | views::reverse) {
+      if (size < 0 || size > catalogue.max_size() || heights == kMalformed) {
+        break;
+      }
+      auto bucket = catalogue.bucket(size);
+      auto it = ranges::find_if(bucket, [&](GraphId graph) {
+        return catalogue.staircases[graph] == heights;
+      });
+      if (it == bucket.end()) {
+        break;
+      }
+      witness.push_back(*it);
+    }
+    if (witness.size() != size_sequence.size()) {
+      cerr << "witness does not match the catalogue: " << line << "\n";
+      ++rejected;
+      continue;
+    }
+    res.emplace(move(size_sequence), move(witness));
+  }
+  return res;
+}
+
+// A worker of check_frontier; witnesses are tested by the matching DFS.
+struct WitnessWorker {
+  const GraphCatalogue &catalogue;
+  MatchingState state;
+
+  explicit WitnessWorker(const GraphCatalogue &catalogue)
+      : catalogue(catalogue), state(catalogue) {}
+
+  bool unmatchable(const GraphSequence &witness) {
+    state.reset();
+    return !gen_matching(witness.begin(), witness.end(), state);
+  }
+
+  optional<GraphSequence> find_witness(const vector<int> &size_sequence) {
+    return ::find_witness(size_sequence, catalogue);
+  }
+};
+
+struct Options {
+  int thread_count = 0;
+  double progress_interval = 5;
+  string stats_path;
+  string trace_path;
+  string witness_path;
+  string state_path;
+  double budget_seconds = 0;
+  uint64_t max_tests = 0;
+  uint64_t samples = 0;
+  bool biased = true;
+  uint64_t seed = 1;
+  bool check = false;
+  bool count = false;
+  string spill_dir;
+};
+
+constexpr string_view kUsage =
+    "usage: 3_partite [THREADS] [--progress SECONDS] [--stats FILE]\n"
+    "                 [--check] [--witness FILE] [--state FILE]\n"
+    "                 [--budget SECONDS] [--max-tests N] [--sample N]\n"
+    "                 [--sampler biased|uniform] [--seed N] [--trace FILE]\n"
+    "                 [--count] [--spill DIR]\n";
+
+// The options are those of 2_partite, except:
+// - --cache: the matching DFS remembers failed vertex masks, and the cache
+//   key is built from antipaths, which hypergraphs do not have;
+// - --bench: its micro benchmarks time the graph backends;
+// - --matching and --validate: the DFS is the only backend;
+// - --chains: its containment lattice indexes the edges of graphs;
+// - --through: the frontier of s is lifted to s + 1 by a star, which has no
+//   counterpart for hypergraphs here, and above s = 3 only --sample is in
+//   reach anyway.
+// s is read from stdin, at most kMaxS = 4, and only s <= 3 is in exhaustive
+// reach; s = 4 takes --sample. parse_options prints kUsage and returns
+// nothing on an unknown option, a missing value or a value that does not
+// parse.
+optional<Options> parse_options(int argc, const char *argv[]) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    try {
+      if (arg == "--progress" && i + 1 < argc) {
+        options.progress_interval = stod(argv[++i]);
+      } else if (arg == "--stats" && i + 1 < argc) {
+        options.stats_path = argv[++i];
+      } else if (arg == "--trace" && i + 1 < argc) {
+        options.trace_path = argv[++i];
+      } else if (arg == "--witness" && i + 1 < argc) {
+        options.witness_path = argv[++i];
+      } else if (arg == "--state" && i + 1 < argc) {
+        options.state_path = argv[++i];
+      } else if (arg == "--budget" && i + 1 < argc) {
+        options.budget_seconds = stod(argv[++i]);
+      } else if (arg == "--max-tests" && i + 1 < argc) {
+        options.max_tests = stoull(argv[++i]);
+      } else if (arg == "--sample" && i + 1 < argc) {
+        options.samples = stoull(argv[++i]);
+      } else if (arg == "--sampler" && i + 1 < argc) {
+        options.biased = string(argv[++i]) != "uniform";
+      } else if (arg == "--seed" && i + 1 < argc) {
+        options.seed = stoull(argv[++i]);
+      } else if (arg == "--check") {
+        options.check = true;
+      } else if (arg == "--count") {
+        options.count = true;
+      } else if (arg == "--spill" && i + 1 < argc) {
+        options.spill_dir = argv[++i];
+      } else if (!arg.empty() &&
+                 arg.find_first_not_of("0123456789") == string::npos) {
+        options.thread_count = stoi(arg);
+      } else {
+        cerr << "unknown option or missing value: " << arg << "\n" << kUsage;
+        return nullopt;
+      }
+    } catch (const logic_error &) {
+      cerr << "bad value for " << arg << ": " << argv[i] << "\n" << kUsage;
+      return nullopt;
+    }
+  }
+  return options;
+}
+
+int main(int argc, const char *argv[]) {
+  auto parsed = parse_options(argc, argv);
+  if (!parsed) {
+    return 1;
+  }
+  const auto &options = *parsed;
+  int s;
+  cin >> s;
+  if (s < 1 || s > kMaxS) {
+    cerr << "s must be between 1 and " << kMaxS << "\n";
+    return 1;
+  }
+  GraphCatalogue catalogue(s);
+  if (options.check) {
+    auto frontier = read_size_sequences(cin);
+    int thread_count = (options.thread_count == 0
+                            ? (int)thread::hardware_concurrency()
+                            : options.thread_count);
+    return check_frontier<GraphSequence>(
+               catalogue, frontier, options.witness_path, thread_count,
+               [&] { return WitnessWorker(catalogue); })
+               ? 0
+               : 1;
+  }
+  if (options.count) {
+    auto frontier = read_size_sequences(cin);
+    int thread_count = (options.thread_count == 0
+                            ? (int)thread::hardware_concurrency()
+                            : options.thread_count);
+    auto count_row = [&](const vector<int> &row, GraphId first) {
+      return count_failures(row, first, catalogue);
+    };
+    return count_frontier(catalogue, frontier, thread_count, count_row) ? 0
+                                                                        : 1;
+  }
+  cout << s << endl;
+  if (options.samples > 0 && !options.state_path.empty()) {
+    cerr << "--sample cannot be combined with --state\n";
+    return 1;
+  }
+  SizeSequenceRanking ranking(s, catalogue.max_size());
+  Boundary<GraphSequence> boundary(options.spill_dir);
+  if (!options.state_path.empty()) {
+    ifstream in(options.state_path);
+    if (in && !read_state(in, ranking, boundary)) {
+      return 1;
+    }
+  }
+  Budget budget;
+  if (options.budget_seconds > 0) {
+    budget.deadline =
+        chrono::steady_clock::now() +
+        chrono::duration_cast<chrono::steady_clock::duration>(
+            chrono::duration<double>(options.budget_seconds));
+  }
+  if (options.max_tests > 0) {
+    budget.max_tests = options.max_tests;
+  }
+  int thread_count = (options.thread_count == 0
+                          ? (int)min<uint64_t>(thread::hardware_concurrency(),
+                                               ranking.size())
+                          : options.thread_count);
+  vector<SearchStats> stats(thread_count);
+  for (auto &st : stats) {
+    st.tracing = !options.trace_path.empty();
+  }
+  auto start = chrono::steady_clock::now();
+  {
+    jthread reporter;
+    if (STATS && options.progress_interval > 0) {
+      reporter = jthread(report_progress, options.progress_interval,
+                         ranking.size(), cref(stats));
+    }
+    vector<jthread> threads;
+    for (int i = 0; i < thread_count; ++i) {
+      threads.emplace_back([i, thread_count, &ranking, &catalogue,
+                            &boundary, &budget, &stats, &options] {
+        optional<TupleSampler> sampler;
+        if (options.samples > 0) {
+          sampler.emplace(catalogue, options.samples, options.biased,
+                          options.seed + i);
+        }
+        // With a sampler the test is the sampler's.
+        auto fails = [&](const vector<int> &size_sequence,
+                         optional<GraphSequence> &witness) {
+          if (sampler) {
+            return sampler->fails(size_sequence, stats[i], witness.emplace());
+          }
+          return sweep_fails(size_sequence, catalogue, stats[i],
+                             &witness.emplace());
+        };
+        do_stuff(views::iota(uint64_t{0}, ranking.size()) | views::reverse |
+                     views::drop(i) | views::stride(thread_count) |
+                     views::transform([&ranking](uint64_t rank) {
+                       return ranking.unrank(rank);
+                     }),
+                 catalogue.max_size(), boundary, budget, stats[i], fails);
+      });
+    }
+    for (auto &thrd : threads) {
+      thrd.join();
+    }
+  }
+  if (STATS && !options.stats_path.empty()) {
+    write_stats_json(
+        options.stats_path, s,
+        chrono::duration<double>(chrono::steady_clock::now() - start).count(),
+        stats);
+  }
+  if (!options.trace_path.empty()) {
+    write_trace_json(options.trace_path, start, stats);
+  }
+  if (!options.state_path.empty()) {
+    ofstream out(options.state_path);
+    write_state(out, s, catalogue.max_size(), boundary, ranking);
+  }
+  if (budget.exhausted) {
+    cerr << "budget exhausted\n";
+    return 2;
+  }
+  if (options.samples > 0) {
+    cerr << "sampled: the frontier is a candidate, confirm it with --check\n";
+  }
+  vector<vector<int>> total = boundary.failing.rows();
+  for (const auto &seq : total) {
+    for (const auto &x : seq) {
+      cout << x << " ";
+    }
+    cout << endl;
+  }
+  if (!options.witness_path.empty()) {
+    ofstream out(options.witness_path);
+    for (const auto &seq : total) {
+      auto it = boundary.witnesses.find(seq);
+      write_witness(out, catalogue, seq,
+                    it != boundary.witnesses.end()
+                        ? it->second
+                        : *find_witness(seq, catalogue));
+    }
+  }
+}
@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <generator>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+struct MatchingState {
+  int s;
+  // x is bit x - 1, y is bit s + y - 1 and z is bit 2s + z - 1.
+  uint32_t used = 0;
+  vector<array<int, 3>> matching;
+
+  explicit MatchingState(int s) : s(s) {}
+
+  void reset() {
+    used = 0;
+    matching.clear();
+  }
+
+  uint32_t edge_bits(int x, int y, int z) const {
+    return 1u << (x - 1) | 1u << (s + y - 1) | 1u << (2 * s + z - 1);
+  }
+};
+
+// A down-set of [s]^3 stored as its staircase: (x, y, z) is an edge iff
+// z <= height(x, y). Heights are packed four bits per cell, row by row.
+struct ShiftedGraph {
+  int s;
+  uint64_t heights;
+
+  int height(int x, int y) const {
+    return heights >> (4 * ((x - 1) * s + y - 1)) & 15;
+  }
+
+  generator<const array<int, 3> &> edges() const {
+    for (int x = 1; x <= s; ++x) {
+      for (int y = 1; y <= s; ++y) {
+        for (int z = 1; z <= height(x, y); ++z) {
+          co_yield {x, y, z};
+        }
+      }
+    }
+  }
+
+  int edge_count() const {
+    int res = 0;
+    for (int cell = 0; cell < s * s; ++cell) {
+      res += heights >> (4 * cell) & 15;
+    }
+    return res;
+  }
+
+  bool lies_inside(const ShiftedGraph &other) const {
+    for (int x = 1; x <= s; ++x) {
+      for (int y = 1; y <= s; ++y) {
+        if (height(x, y) > other.height(x, y)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+};
+
+generator<uint64_t> gen_graphs(int s, int cell, uint64_t heights) {
+  if (cell == s * s) {
+    co_yield heights;
+  } else {
+    int max_h = s;
+    if (cell >= s) {
+      max_h = min<int>(max_h, heights >> (4 * (cell - s)) & 15);
+    }
+    if (cell % s > 0) {
+      max_h = min<int>(max_h, heights >> (4 * (cell - 1)) & 15);
+    }
+    for (int h = 0; h <= max_h; ++h) {
+      for (uint64_t graph :
+           gen_graphs(s, cell + 1, heights | (uint64_t)h << (4 * cell))) {
+        co_yield graph;
+      }
+    }
+  }
+}
+
+bool gen_matching(input_iterator auto graphs_begin,
+                  input_iterator auto graphs_end, MatchingState &state) {
+  if (graphs_begin == graphs_end) {
+    return true;
+  }
+  const ShiftedGraph &graph = *graphs_begin++;
+  for (auto [x, y, z] : graph.edges()) {
+    uint32_t edge = state.edge_bits(x, y, z);
+    if (state.used & edge) {
+      continue;
+    }
+    state.used |= edge;
+    state.matching.push_back({x, y, z});
+    if (gen_matching(graphs_begin, graphs_end, state)) {
+      return true;
+    }
+    state.matching.pop_back();
+    state.used &= ~edge;
+  }
+  return false;
+}
+
+using GraphSequence = vector<reference_wrapper<const ShiftedGraph>>;
+
+generator<GraphSequence>
+gen_graph_sequences(input_iterator auto size_begin,
+                    input_iterator auto size_end,
+                    const vector<vector<ShiftedGraph>> &graphs_by_size) {
+  if (size_begin == size_end) {
+    co_yield {};
+  } else {
+    for (auto &&sequence :
+         gen_graph_sequences(next(size_begin), size_end, graphs_by_size)) {
+      for (auto &&graph : graphs_by_size[*size_begin]) {
+        sequence.push_back(graph);
+        co_yield sequence;
+        sequence.pop_back();
+      }
+    }
+  }
+}
+
+bool has_matching(const GraphSequence &graph_sequence, MatchingState &state) {
+  state.reset();
+  return gen_matching(graph_sequence.begin(), graph_sequence.end(), state);
+}
+
+// Every graph as its staircase seen from above: x grows to the right, y
+// upwards, a cell shows its height. The cell of the edge (x, y, z) that
+// `matching` takes from a graph shows z as a letter, a for 1.
+void print_graph_sequence(const GraphSequence &graph_sequence,
+                          vector<array<int, 3>> matching = {}) {
+  cout << endl;
+  int s = graph_sequence[0].get().s;
+  string alphabet = "ABCDEFGHIJKLMNOPQRST";
+  for (int y = s + 1; y >= 0; --y) {
+    cout << (y >= 1 ? alphabet[y - 1] : '.') << '|';
+    for (const auto &[i, graph] :
+         graph_sequence | views::enumerate | views::reverse) {
+      auto [xm, ym, zm] =
+          (i < matching.size() ? matching[i] : array<int, 3>{-1, -1, -1});
+      for (int x = 1; x <= s; ++x) {
+        if (y > s) {
+          cout << '-';
+        } else if (y == 0) {
+          cout << x % 10;
+        } else if (x == xm && y == ym) {
+          cout << (char)('a' + zm - 1);
+        } else if (int h = graph.get().height(x, y); h > 0) {
+          cout << h;
+        } else {
+          cout << ' ';
+        }
+      }
+      cout << '|';
+    }
+    cout << "\n";
+  }
+}
+
+bool check_embedded(const GraphSequence &graph_sequence) {
+  for (unsigned i = 0; i + 1 < graph_sequence.size(); ++i) {
+    if (!graph_sequence[i].get().lies_inside(graph_sequence[i + 1].get())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void draw_graph(std::vector<int> size_sequence,
+                const vector<vector<ShiftedGraph>> &graphs_by_size) {
+  cout << "sequence {";
+  for (auto it = size_sequence.begin(); next(it) != size_sequence.end(); ++it) {
+    cout << *it << ',';
+  }
+  cout << size_sequence.back();
+  cout << '}' << "\n";
+  cout << "doesn't admit a matching, corresponding sequences:\n";
+  int s = size_sequence.size();
+  MatchingState matching(s);
+  for (const auto &graph_sequence : gen_graph_sequences(
+           size_sequence.begin(), size_sequence.end(), graphs_by_size)) {
+    bool ok = true;
+    vector<array<int, 3>> first_matching;
+    for (int i = 0; i < graph_sequence.size(); ++i) {
+      GraphSequence subsequence;
+      for (int j = 0; j < graph_sequence.size(); ++j) {
+        if (i != j) {
+          subsequence.push_back(graph_sequence[j]);
+        }
+      }
+      if (!has_matching(subsequence, matching)) {
+        ok = false;
+        break;
+      }
+      if (i + 1 == graph_sequence.size()) {
+        first_matching = matching.matching;
+      }
+    }
+    if (!ok) {
+      continue;
+    }
+    if (!has_matching(graph_sequence, matching)) {
+      if (!check_embedded(graph_sequence)) {
+        cerr << "###############################" << endl;
+        cerr << "NOT EMBEDDED" << endl;
+        cerr << "###############################" << endl;
+      }
+      print_graph_sequence(graph_sequence, first_matching);
+    }
+  }
+}
+
+// Usage: drawer < results/<s>max.txt
+int main() {
+  int s;
+  {
+    string tmp;
+    getline(cin, tmp);
+    s = stoi(tmp);
+  }
+  vector<vector<ShiftedGraph>> graphs_by_size(s * s * s + 1);
+  for (uint64_t heights : gen_graphs(s, 0, 0)) {
+    ShiftedGraph graph{s, heights};
+    graphs_by_size[graph.edge_count()].push_back(graph);
+  }
+  string line;
+  while (getline(cin, line)) {
+    istringstream ss(line);
+    int n;
+    vector<int> current;
+    while (ss >> n) {
+      current.push_back(n);
+    }
+    cerr << "checking ";
+    for (const auto &x : current) {
+      cerr << x << " ";
+    }
+    cerr << endl;
+    draw_graph(current, graphs_by_size);
+    cout << "-------------------------" << endl;
+  }
+}
@@ -0,0 +1,298 @@
+// The search boundary that perebor, 2_partite and 3_partite share: what is
+// known about size sequences, the run budget, the resumable state file, and
+// the loop that tests size sequences and expands them onto the boundary. A
+// family plugs in its test and the type of its witnesses.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "packed_antichain.h"
+#include "search_stats.h"
+#include "size_sequences.h"
+
+// What is known about size sequences so far, shared by all workers: failing
+// is down-closed and kept as its maximal elements, passing is up-closed and
+// kept as its minimal elements. Once every size sequence is decided,
+// `failing` is the frontier. Failures whose test found a graph sequence
+// without a rainbow matching keep it in `witnesses`.
+template <class Witness> struct Boundary {
+  std::shared_mutex mtx;
+  PackedAntichain failing;
+  PackedAntichain passing;
+  std::map<std::vector<int>, Witness> witnesses;
+
+  explicit Boundary(const std::string &spill_dir = {})
+      : failing(false, spill_dir), passing(true, spill_dir) {}
+
+  // Whether seq is known to fail, known to pass, or nullopt.
+  std::optional<bool> lookup(const std::vector<int> &seq) {
+    std::shared_lock lock(mtx);
+    if (failing.covers(seq)) {
+      return true;
+    }
+    if (passing.covers(seq)) {
+      return false;
+    }
+    return std::nullopt;
+  }
+
+  void insert(const std::vector<int> &seq, bool failed,
+              const Witness *witness = nullptr) {
+    std::unique_lock lock(mtx);
+    if (failed && !failing.covers(seq)) {
+      failing.insert(seq);
+      if (witness != nullptr) {
+        witnesses.emplace(seq, *witness);
+      }
+    } else if (!failed && !passing.covers(seq)) {
+      passing.insert(seq);
+    }
+  }
+};
+
+// Limits of a run: a wall-clock deadline and a number of exhaustive tests
+// over all workers. A test that has started always runs to the end.
+struct Budget {
+  std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::time_point::max();
+  uint64_t max_tests = std::numeric_limits<uint64_t>::max();
+  std::atomic<uint64_t> tests = 0;
+  std::atomic<bool> exhausted = false;
+
+  // Claims one test, false once the budget is spent.
+  bool take() {
+    if (exhausted.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    if (tests++ >= max_tests ||
+        (deadline != std::chrono::steady_clock::time_point::max() &&
+         std::chrono::steady_clock::now() >= deadline)) {
+      exhausted = true;
+      return false;
+    }
+    return true;
+  }
+};
+
+// Whether some graph sequence of these sizes has no rainbow matching, by the
+// boundary if it already knows, otherwise by `fails` whose result is added to
+// it. nullopt if that test is over the budget. `fails(size_sequence,
+// witness)` is the family's test; it may leave the graph sequence that failed
+// in `witness`.
+template <class Witness, class Test>
+std::optional<bool> decide(const std::vector<int> &size_sequence,
+                           Boundary<Witness> &boundary, Budget &budget,
+                           SearchStats &stats, const Test &fails) {
+  if (auto known = boundary.lookup(size_sequence)) {
+    return *known;
+  }
+  if (!budget.take()) {
+    return std::nullopt;
+  }
+  stats.bump(kSequencesTested);
+  // A build without counters only reads the clock for --trace.
+  bool timed = STATS || stats.tracing;
+  CounterTotals counters{};
+  std::chrono::steady_clock::time_point test_start;
+  if (timed) {
+    counters = stats.totals();
+    test_start = std::chrono::steady_clock::now();
+  }
+  std::optional<Witness> witness;
+  bool failed = fails(size_sequence, witness);
+  if (failed) {
+    stats.bump(kFailures);
+  }
+  if (timed) {
+    stats.record_test(size_sequence,
+                      std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - test_start)
+                          .count());
+    stats.record_span("test", size_sequence, test_start, counters, failed);
+  }
+  boundary.insert(size_sequence, failed, witness ? &*witness : nullptr);
+  return failed;
+}
+
+// Moves a decided size sequence onto the boundary: a failing one is raised to
+// a maximal failing sequence, a passing one lowered to a minimal passing
+// sequence, one colour at a time by binary search on its size. Raising goes
+// from the largest colour down and lowering from the smallest up, so no
+// colour finished earlier could move further afterwards.
+template <class Witness, class Test>
+void expand(std::vector<int> seq, bool failed, int max_size,
+            Boundary<Witness> &boundary, Budget &budget, SearchStats &stats,
+            const Test &fails) {
+  int colours = seq.size();
+  auto probe = [&](int i, int size) {
+    seq[i] = size;
+    return decide(seq, boundary, budget, stats, fails);
+  };
+  if (failed) {
+    for (int i = 0; i < colours; ++i) {
+      int lo = seq[i];
+      int hi = (i == 0 ? max_size : seq[i - 1]);
+      while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        auto probe_failed = probe(i, mid);
+        if (!probe_failed) {
+          return;
+        }
+        if (*probe_failed) {
+          lo = mid;
+        } else {
+          hi = mid - 1;
+        }
+      }
+      seq[i] = lo;
+    }
+  } else {
+    for (int i = colours - 1; i >= 0; --i) {
+      int lo = (i == colours - 1 ? 1 : seq[i + 1]);
+      int hi = seq[i];
+      while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        auto probe_failed = probe(i, mid);
+        if (!probe_failed) {
+          return;
+        }
+        if (*probe_failed) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      seq[i] = hi;
+    }
+  }
+}
+
+// Every size sequence not yet decided by the boundary is tested and then
+// expanded onto the boundary, so most sequences on either side are decided
+// without a test of their own. Stops when the budget is spent.
+template <class Witness, class Test>
+void do_stuff(const std::ranges::range auto &size_sequences, int max_size,
+              Boundary<Witness> &boundary, Budget &budget, SearchStats &stats,
+              const Test &fails) {
+  for (const auto &size_sequence : size_sequences) {
+    stats.bump(kSequencesEnumerated);
+    if (boundary.lookup(size_sequence)) {
+      stats.bump(kSequencesSkipped);
+      continue;
+    }
+    CounterTotals counters{};
+    std::chrono::steady_clock::time_point start;
+    if (stats.tracing) {
+      counters = stats.totals();
+      start = std::chrono::steady_clock::now();
+    }
+    auto failed = decide(size_sequence, boundary, budget, stats, fails);
+    if (!failed) {
+      return;
+    }
+    expand(size_sequence, *failed, max_size, boundary, budget, stats, fails);
+    stats.record_span("sequence", size_sequence, start, counters, *failed);
+  }
+}
+
+// The state of a search, one line per entry after `s <s>`: `frontier` rows
+// fail and every minimal increment of them is known to pass, `failing` rows
+// are known to fail (a lower bound: the frontier lies on or above them),
+// `passing` rows are the minimal sequences known to pass (an upper bound: the
+// frontier lies below them). `undecided lo hi` are the ranks [lo, hi) of the
+// ranking that neither side decides yet, so a run of undecided sequences
+// takes one line. A search resumed from it only tests undecided sequences.
+template <class Witness>
+void write_state(std::ostream &out, int s, int max_size,
+                 Boundary<Witness> &boundary,
+                 const SizeSequenceRanking &ranking) {
+  auto write_row = [&out](std::string_view kind, const std::vector<int> &seq) {
+    out << kind;
+    for (int x : seq) {
+      out << " " << x;
+    }
+    out << "\n";
+  };
+  out << "s " << s << "\n";
+  int confirmed = 0;
+  uint64_t undecided = 0;
+  for (const auto &seq : boundary.failing.rows()) {
+    bool maximal = std::ranges::all_of(
+        minimal_increments(seq, max_size),
+        [&](const auto &inc) { return boundary.passing.covers(inc); });
+    write_row(maximal ? "frontier" : "failing", seq);
+    confirmed += maximal;
+  }
+  for (const auto &seq : boundary.passing.rows()) {
+    write_row("passing", seq);
+  }
+  auto is_undecided = [&](uint64_t rank) {
+    return rank < ranking.size() && !boundary.lookup(ranking.unrank(rank));
+  };
+  for (uint64_t rank = 0; rank < ranking.size(); ++rank) {
+    if (is_undecided(rank)) {
+      uint64_t lo = rank;
+      while (is_undecided(rank + 1)) {
+        ++rank;
+      }
+      out << std::format("undecided {} {}\n", lo, rank + 1);
+      undecided += rank + 1 - lo;
+    }
+  }
+  std::cerr << std::format("{} frontier rows confirmed, {} failing and {} "
+                           "passing bounds, {} size sequences undecided\n",
+                           confirmed, boundary.failing.size() - confirmed,
+                           boundary.passing.size(), undecided);
+}
+
+// Loads the failing and passing rows of a state written by write_state and
+// checks that its undecided ranks are ranges of this ranking.
+template <class Witness>
+bool read_state(std::istream &in, const SizeSequenceRanking &ranking,
+                Boundary<Witness> &boundary) {
+  int s = ranking.s;
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream ss(line);
+    std::string kind;
+    ss >> kind;
+    if (kind == "undecided") {
+      uint64_t lo, hi;
+      if (!(ss >> lo >> hi) || lo >= hi || hi > ranking.size()) {
+        std::cerr << "bad range of undecided ranks: " << line << "\n";
+        return false;
+      }
+      continue;
+    }
+    std::vector<int> seq;
+    int n;
+    while (ss >> n) {
+      seq.push_back(n);
+    }
+    if (kind == "s" && seq != std::vector{s}) {
+      std::cerr << "state is for another s: " << line << "\n";
+      return false;
+    }
+    if (kind == "frontier" || kind == "failing") {
+      boundary.insert(seq, true);
+    } else if (kind == "passing") {
+      boundary.insert(seq, false);
+    }
+  }
+  return true;
+}
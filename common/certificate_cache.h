@@ -0,0 +1,303 @@
+// The certificate cache shared by perebor, 2_partite and their drawers: the
+// key of a graph sequence, the file format and its locking, and the lookup
+// that checks a cached matching before trusting it.
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <ranges>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct Certificate {
+  bool matchable;
+  // One edge per colour, in the canonical order of the cache key.
+  std::vector<std::pair<int, int>> matching;
+};
+
+// The cache key of a graph sequence, which does not depend on the order of
+// the colours: s, then the antipath of every graph closed by 0xff, sorted.
+// `antipaths` holds the antipath of each graph, a range of (x, y) corners, in
+// graph sequence order. order[i] is the position in the graph sequence of the
+// i-th graph of the key.
+template <class Antipaths>
+std::string canonical_key(int s, Antipaths &&antipaths,
+                          std::vector<int> &order) {
+  std::vector<std::string> encoded;
+  for (const auto &antipath : antipaths) {
+    auto &enc = encoded.emplace_back();
+    for (auto [x, y] : antipath) {
+      enc.push_back((char)x);
+      enc.push_back((char)y);
+    }
+    enc.push_back((char)0xff);
+  }
+  order.resize(encoded.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::ranges::sort(order, {}, [&](int i) -> const std::string & {
+    return encoded[i];
+  });
+  std::string key(1, (char)s);
+  for (int i : order) {
+    key += encoded[i];
+  }
+  return key;
+}
+
+// Persistent, content-addressed store of matchability certificates, shared
+// between runs and between a search and its drawer. The search itself never
+// consults it: its sweep decides whole buckets at once. Certificates come
+// from --check, from witnesses a search looks up after the fact, and from
+// the drawer. The file is an append-only log of records keyed by
+// canonical_key, after a header naming the family of graphs, so that the
+// caches of perebor and 2_partite cannot be mixed up. Records present on
+// open are served from a read-only memory map; records inserted during the
+// run are kept in memory and appended to the file by flush().
+struct CertificateCache {
+  struct RecordHeader {
+    uint64_t hash;
+    uint16_t key_size;
+    uint8_t matchable;
+    uint8_t matching_size;
+  };
+  static constexpr std::string_view kMagic = "RBWCERT2 ";
+
+  // Holds the exclusive file lock that every change of the file takes.
+  struct FileLock {
+    int fd;
+    explicit FileLock(int fd) : fd(fd) { flock(fd, LOCK_EX); }
+    ~FileLock() { flock(fd, LOCK_UN); }
+  };
+
+  int fd = -1;
+  const char *data = nullptr;
+  size_t size = 0;
+  // Graph sequences decided within this many DFS nodes bypass the cache.
+  uint64_t min_nodes = 100;
+  // The magic, then the family, then a newline.
+  std::string header;
+  // hash of the key -> offsets of the records with that hash in data
+  std::unordered_multimap<uint64_t, size_t> index;
+  std::shared_mutex mtx;
+  std::unordered_map<std::string, Certificate> inserted;
+  std::string unflushed;
+  bool writable = true;
+
+  // Creating the file and scanning it happen under the file lock, so another
+  // process can neither write the header twice nor append half a record
+  // meanwhile. A file of another family is rejected.
+  CertificateCache(const std::string &path, std::string_view family)
+      : header(std::string(kMagic) + std::string(family) + "\n") {
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("cannot open certificate cache " + path);
+    }
+    FileLock lock(fd);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      throw std::runtime_error("cannot stat certificate cache " + path);
+    }
+    size = st.st_size;
+    if (size == 0) {
+      if (!append(header)) {
+        throw std::runtime_error("cannot write certificate cache " + path);
+      }
+      return;
+    }
+    data = (const char *)mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED || size < kMagic.size() ||
+        std::string_view(data, kMagic.size()) != kMagic) {
+      throw std::runtime_error("not a certificate cache: " + path);
+    }
+    if (size < header.size() ||
+        std::string_view(data, header.size()) != header) {
+      throw std::runtime_error("certificate cache " + path +
+                               " belongs to another family than " +
+                               std::string(family));
+    }
+    size_t offset = header.size();
+    while (offset + sizeof(RecordHeader) <= size) {
+      RecordHeader record;
+      memcpy(&record, data + offset, sizeof(record));
+      size_t record_size =
+          sizeof(record) + record.key_size + 2 * record.matching_size;
+      if (offset + record_size > size) {
+        break;
+      }
+      index.emplace(record.hash, offset);
+      offset += record_size;
+    }
+    // A record cut short by a crashed append is cut off, so the next append
+    // starts on a record boundary.
+    if (offset < size && ftruncate(fd, offset) != 0) {
+      throw std::runtime_error("cannot repair certificate cache " + path);
+    }
+  }
+
+  CertificateCache(const CertificateCache &) = delete;
+
+  ~CertificateCache() {
+    flush();
+    if (data != nullptr && data != MAP_FAILED) {
+      munmap((void *)data, size);
+    }
+    close(fd);
+  }
+
+  static uint64_t hash(std::string_view key) {
+    uint64_t h = 14695981039346656037ull;
+    for (char c : key) {
+      h = (h ^ (uint8_t)c) * 1099511628211ull;
+    }
+    return h;
+  }
+
+  std::optional<Certificate> lookup(const std::string &key) {
+    auto [begin, end] = index.equal_range(hash(key));
+    for (auto it = begin; it != end; ++it) {
+      RecordHeader record;
+      memcpy(&record, data + it->second, sizeof(record));
+      const char *record_key = data + it->second + sizeof(record);
+      if (std::string_view(record_key, record.key_size) == key) {
+        Certificate res{(bool)record.matchable, {}};
+        const char *edges = record_key + record.key_size;
+        for (int i = 0; i < record.matching_size; ++i) {
+          res.matching.emplace_back(edges[2 * i], edges[2 * i + 1]);
+        }
+        return res;
+      }
+    }
+    std::shared_lock lock(mtx);
+    if (auto it = inserted.find(key); it != inserted.end()) {
+      return it->second;
+    }
+    return std::nullopt;
+  }
+
+  void insert(const std::string &key, const Certificate &certificate) {
+    std::unique_lock lock(mtx);
+    if (!inserted.emplace(key, certificate).second) {
+      return;
+    }
+    // Value-initialised, so the padding written to the file is zero.
+    RecordHeader record{};
+    record.hash = hash(key);
+    record.key_size = key.size();
+    record.matchable = certificate.matchable;
+    record.matching_size = certificate.matching.size();
+    unflushed.append((const char *)&record, sizeof(record));
+    unflushed += key;
+    for (auto [x, y] : certificate.matching) {
+      unflushed.push_back((char)x);
+      unflushed.push_back((char)y);
+    }
+    if (unflushed.size() >= (1 << 20)) {
+      flush_locked();
+    }
+  }
+
+  // The cached answer for a graph sequence with this key and order (see
+  // canonical_key): false if it has no rainbow matching; true if the cached
+  // matching, put into `matching` in graph sequence order, passes
+  // verify(matching); nullopt otherwise. "No matching" cannot be checked as
+  // cheaply and is trusted, which the family in the header makes safe.
+  template <class Verify>
+  std::optional<bool> lookup_matching(
+      const std::string &key, const std::vector<int> &order,
+      std::vector<std::pair<int, int>> &matching, const Verify &verify) {
+    auto certificate = lookup(key);
+    if (!certificate) {
+      return std::nullopt;
+    }
+    if (!certificate->matchable) {
+      return false;
+    }
+    if (certificate->matching.size() != order.size()) {
+      return std::nullopt;
+    }
+    matching.resize(order.size());
+    for (int i = 0; i < order.size(); ++i) {
+      matching[order[i]] = certificate->matching[i];
+    }
+    if (verify(matching)) {
+      return true;
+    }
+    return std::nullopt;
+  }
+
+  // Caches the answer for a graph sequence with this key and order; a
+  // matching is given in graph sequence order.
+  void insert_matching(const std::string &key, const std::vector<int> &order,
+                       bool matchable,
+                       const std::vector<std::pair<int, int>> &matching) {
+    Certificate certificate{matchable, {}};
+    if (matchable) {
+      for (int i : order) {
+        certificate.matching.push_back(matching[i]);
+      }
+    }
+    insert(key, certificate);
+  }
+
+  void flush() {
+    std::unique_lock lock(mtx);
+    flush_locked();
+  }
+
+  // Writes all of bytes at the end of the file, or nothing: a failed or
+  // short write is cut off again. The caller holds the file lock.
+  bool append(std::string_view bytes) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      return false;
+    }
+    for (size_t done = 0; done < bytes.size();) {
+      ssize_t n = write(fd, bytes.data() + done, bytes.size() - done);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        int error = errno;
+        // Should the cut fail too, the torn record would misalign every
+        // later append, so this process stops appending.
+        writable = ftruncate(fd, st.st_size) == 0;
+        errno = error;
+        return false;
+      }
+      done += n;
+    }
+    return true;
+  }
+
+  // Several processes may share a cache file, so every batch of records is
+  // appended under an exclusive file lock. A batch that cannot be written is
+  // dropped; the certificates are only recomputed by later runs.
+  void flush_locked() {
+    if (unflushed.empty()) {
+      return;
+    }
+    FileLock lock(fd);
+    if (writable && !append(unflushed)) {
+      std::cerr << "certificate cache: dropped " << unflushed.size()
+                << " bytes of records: " << strerror(errno) << "\n";
+    }
+    unflushed.clear();
+  }
+};
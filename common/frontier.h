@@ -0,0 +1,217 @@
+// --check and --count of perebor, 2_partite and 3_partite: both take a
+// frontier on stdin and spread its rows over worker threads. A family plugs
+// in its catalogue, its witnesses and how a worker tests graph sequences.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "size_sequences.h"
+
+// Whether every row is a size sequence of s colours within max_size; the
+// first that is not is reported.
+inline bool are_size_sequences(const std::vector<std::vector<int>> &rows,
+                               int s, int max_size) {
+  for (const auto &row : rows) {
+    if (row.size() != s || !std::ranges::is_sorted(row, std::greater<>()) ||
+        row.back() < 1 || row.front() > max_size) {
+      std::cerr << "not a size sequence:";
+      for (int x : row) {
+        std::cerr << " " << x;
+      }
+      std::cerr << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+// Verifies a frontier in time proportional to the frontier: it must be an
+// antichain of non-increasing sequences, every row must fail (confirmed by a
+// stored witness when there is one, otherwise by searching for it) and every
+// minimal sequence outside the down-set of the rows must admit a matching for
+// all of its graph sequences. Those include the minimal increments of the
+// rows but can be more, so that a frontier missing a row is caught. Returns
+// whether the frontier is correct.
+//
+// Every thread gets a worker from make_worker(), with `unmatchable(witness)`
+// testing a stored witness and `find_witness(size_sequence)` searching for
+// one. The family's read_witnesses and write_witness for its catalogue read
+// and write the witness file.
+template <class Witness, class Catalogue, class MakeWorker>
+bool check_frontier(const Catalogue &catalogue,
+                    const std::vector<std::vector<int>> &frontier,
+                    const std::string &witness_path, int thread_count,
+                    const MakeWorker &make_worker) {
+  int s = catalogue.s;
+  int max_size = catalogue.max_size();
+  if (!are_size_sequences(frontier, s, max_size)) {
+    return false;
+  }
+  bool ok = true;
+  for (const auto &lhs : frontier) {
+    for (const auto &rhs : frontier) {
+      if (&lhs != &rhs && is_better(lhs, rhs)) {
+        std::cerr << "frontier is not an antichain\n";
+        ok = false;
+      }
+    }
+  }
+
+  std::map<std::vector<int>, Witness> witnesses;
+  bool have_witnesses = false;
+  if (!witness_path.empty()) {
+    std::ifstream in(witness_path);
+    if (in) {
+      int rejected = 0;
+      witnesses = read_witnesses(in, catalogue, rejected);
+      have_witnesses = true;
+      ok = ok && rejected == 0;
+    }
+  }
+  auto outside = minimal_non_members(frontier, s, max_size);
+
+  // Tasks [0, frontier.size()) confirm rows, the rest refute the sequences
+  // outside.
+  std::vector<std::optional<Witness>> found(frontier.size() + outside.size());
+  std::vector<char> bad_witness(frontier.size());
+  std::atomic<int> next_task = 0;
+  {
+    std::vector<std::jthread> threads;
+    for (int i = 0; i < thread_count; ++i) {
+      threads.emplace_back([&] {
+        auto worker = make_worker();
+        for (int task; (task = next_task++) < found.size();) {
+          if (task < frontier.size()) {
+            const auto &row = frontier[task];
+            if (auto it = witnesses.find(row); it != witnesses.end()) {
+              if (worker.unmatchable(it->second)) {
+                found[task] = it->second;
+              } else {
+                bad_witness[task] = true;
+              }
+            } else {
+              found[task] = worker.find_witness(row);
+            }
+          } else {
+            found[task] = worker.find_witness(outside[task - frontier.size()]);
+          }
+        }
+      });
+    }
+  }
+
+  for (int i = 0; i < frontier.size(); ++i) {
+    const auto &row = frontier[i];
+    if (bad_witness[i]) {
+      std::cerr << "stored witness admits a matching:";
+      for (int x : row) {
+        std::cerr << " " << x;
+      }
+      std::cerr << "\n";
+      ok = false;
+    } else if (!found[i]) {
+      std::cerr << "row admits a matching for all graph sequences:";
+      for (int x : row) {
+        std::cerr << " " << x;
+      }
+      std::cerr << "\n";
+      ok = false;
+    }
+  }
+  for (const auto &[seq, witness] :
+       std::views::zip(outside, found | std::views::drop(frontier.size()))) {
+    if (witness) {
+      std::cerr << "fails but is not covered by the frontier:";
+      for (int x : seq) {
+        std::cerr << " " << x;
+      }
+      std::cerr << "\n";
+      ok = false;
+    }
+  }
+  if (ok && !witness_path.empty() && !have_witnesses) {
+    std::ofstream out(witness_path);
+    for (const auto &[row, witness] : std::views::zip(frontier, found)) {
+      write_witness(out, catalogue, row, *witness);
+    }
+  }
+  std::cerr << std::format("checked {} rows ({} with stored witnesses) and {} "
+                           "minimal sequences outside: {}\n",
+                           frontier.size(), witnesses.size(), outside.size(),
+                           ok ? "ok" : "FAILED");
+  return ok;
+}
+
+struct FailureCounts {
+  uint64_t tuples = 0;
+  uint64_t failing = 0;
+  uint64_t minimal = 0;
+};
+
+// The table of --count: every frontier row followed by its number of graph
+// sequences, of those without a rainbow matching and of the minimal ones.
+// `count_row(row, first)` counts the graph sequences of a row whose first
+// colour is the graph `first`. Returns false on a row that is not a size
+// sequence.
+template <class Catalogue, class CountRow>
+bool count_frontier(const Catalogue &catalogue,
+                    const std::vector<std::vector<int>> &frontier,
+                    int thread_count, const CountRow &count_row) {
+  using GraphId = std::ranges::range_value_t<decltype(catalogue.bucket_begin)>;
+  int s = catalogue.s;
+  if (!are_size_sequences(frontier, s, catalogue.max_size())) {
+    return false;
+  }
+  // One task per row and graph of its first colour.
+  std::vector<std::pair<int, GraphId>> tasks;
+  for (const auto &[row, seq] : frontier | std::views::enumerate) {
+    if (s == 1) {
+      tasks.emplace_back(row, catalogue.bucket_begin[seq[0]]);
+      continue;
+    }
+    for (GraphId graph : catalogue.bucket(seq.back())) {
+      tasks.emplace_back(row, graph);
+    }
+  }
+  std::vector<FailureCounts> counts(tasks.size());
+  std::atomic<int> next_task = 0;
+  {
+    std::vector<std::jthread> threads;
+    for (int i = 0; i < thread_count; ++i) {
+      threads.emplace_back([&] {
+        for (int task; (task = next_task++) < tasks.size();) {
+          auto [row, first] = tasks[task];
+          counts[task] = count_row(frontier[row], first);
+        }
+      });
+    }
+  }
+  std::vector<FailureCounts> by_row(frontier.size());
+  for (const auto &[task, count] : std::views::zip(tasks, counts)) {
+    auto &total = by_row[task.first];
+    total.tuples += count.tuples;
+    total.failing += count.failing;
+    total.minimal += count.minimal;
+  }
+  for (const auto &[row, count] : std::views::zip(frontier, by_row)) {
+    for (int size : row) {
+      std::cout << size << " ";
+    }
+    std::cout << ": " << count.tuples << " " << count.failing << " "
+              << count.minimal << "\n";
+  }
+  return true;
+}
@@ -0,0 +1,268 @@
+// The packed antichain that holds either side of the search boundary in
+// perebor, 2_partite and 3_partite.
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+// An antichain of size sequences of one length, sized for frontiers that do
+// not fit in RAM as node-based sets: the maximal elements of a down-set or,
+// if `upper`, the minimal elements of an up-set. Rows are packed as `width`
+// 16-bit sizes and kept like a log-structured merge tree: an insert goes to
+// a small buffer, a full buffer is sorted into a run, and runs of similar
+// length are merged. A row that an insert makes redundant is marked dead and
+// dropped when its run is next merged. Every run keeps the componentwise
+// minimum and maximum of each block of kBlockRows rows in RAM, so a dominance
+// query binary-searches the first size and then skips whole blocks. With a
+// spill directory, runs of at least kSpillRows rows move to an unlinked file
+// there and are mapped, and only their summaries stay in RAM.
+struct PackedAntichain {
+  static constexpr int kMaxWidth = 16;
+  static constexpr int kBlockRows = 64;
+  static constexpr int kBufferRows = 1024;
+  static constexpr size_t kSpillRows = 1 << 16;
+
+  using Key = std::array<uint16_t, kMaxWidth>;
+
+  struct Run {
+    int width;
+    size_t count;
+    std::vector<uint16_t> rows;
+    const uint16_t *data;
+    size_t mapped_bytes = 0;
+    std::vector<uint16_t> block_min, block_max;
+    std::vector<bool> dead;
+
+    Run(int width, std::vector<uint16_t> &&packed, const std::string &spill_dir)
+        : width(width), count(packed.size() / width), rows(std::move(packed)),
+          data(rows.data()), dead(count) {
+      for (size_t i = 0; i < count; ++i) {
+        if (i % kBlockRows == 0) {
+          block_min.insert(block_min.end(), row(i), row(i) + width);
+          block_max.insert(block_max.end(), row(i), row(i) + width);
+        }
+        uint16_t *lo = &block_min[block_min.size() - width];
+        uint16_t *hi = &block_max[block_max.size() - width];
+        for (int c = 0; c < width; ++c) {
+          lo[c] = std::min(lo[c], row(i)[c]);
+          hi[c] = std::max(hi[c], row(i)[c]);
+        }
+      }
+      if (!spill_dir.empty() && count >= kSpillRows) {
+        spill(spill_dir);
+      }
+    }
+
+    Run(const Run &) = delete;
+
+    ~Run() {
+      if (mapped_bytes > 0) {
+        munmap((void *)data, mapped_bytes);
+      }
+    }
+
+    void spill(const std::string &spill_dir) {
+      std::string path = spill_dir + "/antichain-XXXXXX";
+      int fd = mkstemp(path.data());
+      if (fd < 0) {
+        throw std::runtime_error("cannot create a run file in " + spill_dir);
+      }
+      unlink(path.c_str());
+      size_t bytes = rows.size() * sizeof(uint16_t);
+      for (size_t done = 0; done < bytes;) {
+        ssize_t n = write(fd, (const char *)rows.data() + done, bytes - done);
+        if (n <= 0) {
+          close(fd);
+          throw std::runtime_error("cannot write a run file in " + spill_dir);
+        }
+        done += n;
+      }
+      void *mapping = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+      close(fd);
+      if (mapping == MAP_FAILED) {
+        throw std::runtime_error("cannot map a run file in " + spill_dir);
+      }
+      data = (const uint16_t *)mapping;
+      mapped_bytes = bytes;
+      rows = {};
+    }
+
+    const uint16_t *row(size_t i) const { return data + i * width; }
+  };
+
+  bool upper;
+  std::string spill_dir;
+  int width = 0;
+  size_t live = 0;
+  std::vector<std::unique_ptr<Run>> runs;
+  std::vector<uint16_t> buffer;
+
+  explicit PackedAntichain(bool upper, std::string spill_dir = {})
+      : upper(upper), spill_dir(std::move(spill_dir)) {}
+
+  size_t size() const { return live; }
+
+  Key pack(const std::vector<int> &seq) {
+    if (width == 0) {
+      if (seq.size() > kMaxWidth) {
+        throw std::runtime_error("size sequence longer than kMaxWidth");
+      }
+      width = seq.size();
+    }
+    Key key{};
+    std::ranges::copy(seq, key.begin());
+    return key;
+  }
+
+  // Whether row r is >= key componentwise, or <= key if !above.
+  bool beyond(const uint16_t *r, const Key &key, bool above) const {
+    for (int c = 0; c < width; ++c) {
+      if (above ? r[c] < key[c] : r[c] > key[c]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Calls visit(run, i) on the live rows of the runs beyond key until it
+  // returns true; whether it did.
+  bool scan_runs(const Key &key, bool above, auto &&visit) {
+    for (auto &run : runs) {
+      auto indices = std::views::iota(size_t{0}, run->count);
+      size_t begin = 0, end = run->count;
+      if (above) {
+        begin = *std::ranges::partition_point(
+            indices, [&](size_t i) { return run->row(i)[0] < key[0]; });
+      } else {
+        end = *std::ranges::partition_point(
+            indices, [&](size_t i) { return run->row(i)[0] <= key[0]; });
+      }
+      for (size_t block = begin / kBlockRows; block * kBlockRows < end;
+           ++block) {
+        const auto &summary = above ? run->block_max : run->block_min;
+        if (!beyond(&summary[block * width], key, above)) {
+          continue;
+        }
+        for (size_t i = std::max(begin, block * kBlockRows);
+             i < std::min(end, (block + 1) * kBlockRows); ++i) {
+          if (!run->dead[i] && beyond(run->row(i), key, above) &&
+              visit(*run, i)) {
+            return true;
+          }
+        }
+      }
+    }
+    return false;
+  }
+
+  // Whether some row is >= seq componentwise (<= seq if upper), i.e. whether
+  // seq is in the set the antichain stands for.
+  bool covers(const std::vector<int> &seq) {
+    if (width == 0) {
+      return false;
+    }
+    Key key = pack(seq);
+    for (size_t i = 0; i < buffer.size(); i += width) {
+      if (beyond(&buffer[i], key, !upper)) {
+        return true;
+      }
+    }
+    return scan_runs(key, !upper, [](const Run &, size_t) { return true; });
+  }
+
+  // Adds seq, which must not be covered yet, and drops the rows it covers.
+  void insert(const std::vector<int> &seq) {
+    Key key = pack(seq);
+    size_t kept = 0;
+    for (size_t i = 0; i < buffer.size(); i += width) {
+      if (beyond(&buffer[i], key, upper)) {
+        --live;
+      } else {
+        std::copy_n(&buffer[i], width, &buffer[kept]);
+        kept += width;
+      }
+    }
+    buffer.resize(kept);
+    scan_runs(key, upper, [&](Run &run, size_t i) {
+      run.dead[i] = true;
+      --live;
+      return false;
+    });
+    buffer.insert(buffer.end(), key.begin(), key.begin() + width);
+    ++live;
+    if (buffer.size() == kBufferRows * width) {
+      flush_buffer();
+    }
+  }
+
+  void collect(const Run &run, std::vector<const uint16_t *> &res) const {
+    for (size_t i = 0; i < run.count; ++i) {
+      if (!run.dead[i]) {
+        res.push_back(run.row(i));
+      }
+    }
+  }
+
+  void collect_buffer(std::vector<const uint16_t *> &res) const {
+    for (size_t i = 0; i < buffer.size(); i += width) {
+      res.push_back(&buffer[i]);
+    }
+  }
+
+  std::vector<uint16_t> sorted(std::vector<const uint16_t *> rows) const {
+    std::ranges::sort(rows, [this](const uint16_t *lhs, const uint16_t *rhs) {
+      return std::lexicographical_compare(lhs, lhs + width, rhs, rhs + width);
+    });
+    std::vector<uint16_t> res;
+    res.reserve(rows.size() * width);
+    for (const uint16_t *r : rows) {
+      res.insert(res.end(), r, r + width);
+    }
+    return res;
+  }
+
+  void flush_buffer() {
+    std::vector<const uint16_t *> rows;
+    collect_buffer(rows);
+    runs.push_back(std::make_unique<Run>(width, sorted(rows), spill_dir));
+    buffer.clear();
+    while (runs.size() >= 2 &&
+           runs[runs.size() - 2]->count <= 2 * runs.back()->count) {
+      rows.clear();
+      collect(*runs[runs.size() - 2], rows);
+      collect(*runs.back(), rows);
+      auto run = std::make_unique<Run>(width, sorted(rows), spill_dir);
+      runs.pop_back();
+      runs.back() = std::move(run);
+    }
+  }
+
+  // All rows, sorted.
+  std::vector<std::vector<int>> rows() const {
+    std::vector<std::vector<int>> res;
+    if (width == 0) {
+      return res;
+    }
+    std::vector<const uint16_t *> rows;
+    collect_buffer(rows);
+    for (const auto &run : runs) {
+      collect(*run, rows);
+    }
+    auto packed = sorted(rows);
+    for (size_t i = 0; i < packed.size(); i += width) {
+      res.emplace_back(packed.begin() + i, packed.begin() + i + width);
+    }
+    return res;
+  }
+};
@@ -0,0 +1,234 @@
+// The search counters, the progress line and the --stats and --trace writers
+// shared by perebor, 2_partite and 3_partite.
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <ranges>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+// Build with -DSTATS=0 to compile the search counters out of the hot loops.
+#ifndef STATS
+#define STATS 1
+#endif
+
+enum Counter {
+  kSequencesEnumerated,
+  kSequencesSkipped,
+  kSequencesTested,
+  kGraphSequences,
+  kMatchingNodes,
+  kBucketSweeps,
+  kPrefixPrunes,
+  kFailures,
+  kTestNs,
+  kCounterCount
+};
+
+constexpr std::array<const char *, kCounterCount> counter_names = {
+    "sequences_enumerated", "sequences_skipped", "sequences_tested",
+    "graph_sequences",      "matching_nodes",    "bucket_sweeps",
+    "prefix_prunes",        "failures",          "test_ns"};
+
+using CounterTotals = std::array<uint64_t, kCounterCount>;
+
+// Counters of a single worker thread. Only the owning thread writes them, the
+// progress reporter reads them concurrently, hence relaxed atomics and a cache
+// line per thread.
+struct alignas(64) SearchStats {
+  std::array<std::atomic<uint64_t>, kCounterCount> counters{};
+  // test_histogram[i] counts tested size sequences that took [2^i, 2^(i+1)) us
+  std::array<uint64_t, 32> test_histogram{};
+  uint64_t max_test_ns = 0;
+  std::vector<int> slowest_sequence;
+
+  void bump(Counter counter, uint64_t delta = 1) {
+    if constexpr (STATS) {
+      counters[counter].store(
+          counters[counter].load(std::memory_order_relaxed) + delta,
+          std::memory_order_relaxed);
+    }
+  }
+
+  CounterTotals totals() const {
+    CounterTotals res;
+    for (int i = 0; i < kCounterCount; ++i) {
+      res[i] = counters[i].load(std::memory_order_relaxed);
+    }
+    return res;
+  }
+
+  void record_test(const std::vector<int> &size_sequence, uint64_t ns) {
+    if constexpr (STATS) {
+      bump(kTestNs, ns);
+      ++test_histogram[std::min<int>(std::bit_width(ns / 1000), 31)];
+      if (ns > max_test_ns) {
+        max_test_ns = ns;
+        slowest_sequence = size_sequence;
+      }
+    }
+  }
+
+  // --trace spans: each test, and each size sequence a worker takes up
+  // together with its expansion, with the counters that moved meanwhile.
+  // Every worker appends to its own buffer.
+  struct Span {
+    const char *kind;
+    std::vector<int> size_sequence;
+    std::chrono::steady_clock::time_point start, end;
+    CounterTotals counters;
+    bool failed;
+  };
+  bool tracing = false;
+  std::vector<Span> trace;
+
+  void record_span(const char *kind, const std::vector<int> &size_sequence,
+                   std::chrono::steady_clock::time_point start,
+                   const CounterTotals &before, bool failed) {
+    if (!tracing) {
+      return;
+    }
+    Span span{kind,     size_sequence,
+              start,    std::chrono::steady_clock::now(),
+              totals(), failed};
+    for (int i = 0; i < kCounterCount; ++i) {
+      span.counters[i] -= before[i];
+    }
+    trace.push_back(std::move(span));
+  }
+};
+
+inline CounterTotals sum_stats(const std::vector<SearchStats> &stats) {
+  CounterTotals total{};
+  for (const auto &st : stats) {
+    auto totals = st.totals();
+    for (int i = 0; i < kCounterCount; ++i) {
+      total[i] += totals[i];
+    }
+  }
+  return total;
+}
+
+inline std::string format_duration(double seconds) {
+  int total = (int)seconds;
+  if (total >= 3600) {
+    return std::format("{}h{:02}m", total / 3600, total / 60 % 60);
+  }
+  if (total >= 60) {
+    return std::format("{}m{:02}s", total / 60, total % 60);
+  }
+  return std::format("{:.1f}s", seconds);
+}
+
+// Prints a progress line to stderr every `interval` seconds until stopped.
+inline void report_progress(std::stop_token stop, double interval,
+                            uint64_t sequence_count,
+                            const std::vector<SearchStats> &stats) {
+  auto start = std::chrono::steady_clock::now();
+  std::mutex mtx;
+  std::condition_variable_any cv;
+  std::unique_lock lock(mtx);
+  while (true) {
+    cv.wait_for(lock, stop, std::chrono::duration<double>(interval),
+                [] { return false; });
+    if (stop.stop_requested()) {
+      break;
+    }
+    double elapsed = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    auto total = sum_stats(stats);
+    double rate = total[kSequencesEnumerated] / elapsed;
+    uint64_t left = sequence_count - total[kSequencesEnumerated];
+    std::cerr << std::format(
+        "[{}] {}/{} size sequences ({:.1f}%), {} tested, {} failed, {:.0f} "
+        "seq/s, {:.0f} tuples/s, ETA {}\n",
+        format_duration(elapsed), total[kSequencesEnumerated], sequence_count,
+        100.0 * total[kSequencesEnumerated] / sequence_count,
+        total[kSequencesTested], total[kFailures], rate,
+        total[kGraphSequences] / elapsed,
+        rate > 0 ? format_duration(left / rate) : "?");
+  }
+}
+
+inline void write_stats_json(const std::string &path, int s, double elapsed,
+                             const std::vector<SearchStats> &stats) {
+  std::ofstream out(path);
+  auto write_totals = [&out](const CounterTotals &totals) {
+    for (int i = 0; i < kCounterCount; ++i) {
+      out << std::format("{}\"{}\": {}", i ? ", " : "", counter_names[i],
+                         totals[i]);
+    }
+  };
+  auto write_sequence = [&out](const std::ranges::range auto &sequence) {
+    out << '[';
+    for (int i = 0; i < sequence.size(); ++i) {
+      out << (i ? ", " : "") << sequence[i];
+    }
+    out << ']';
+  };
+  out << std::format(
+      "{{\"s\": {}, \"threads\": {}, \"elapsed_s\": {:.3f}, ", s,
+      stats.size(), elapsed);
+  write_totals(sum_stats(stats));
+  out << ", \"per_thread\": [";
+  for (int i = 0; i < stats.size(); ++i) {
+    out << (i ? ", " : "") << '{';
+    write_totals(stats[i].totals());
+    out << std::format(", \"max_test_ns\": {}, \"slowest_sequence\": ",
+                       stats[i].max_test_ns);
+    write_sequence(stats[i].slowest_sequence);
+    out << ", \"test_us_log2_histogram\": ";
+    write_sequence(stats[i].test_histogram);
+    out << '}';
+  }
+  out << "]}\n";
+}
+
+// The --trace spans in Chrome trace-event JSON, one track per worker, to be
+// opened in chrome://tracing or Perfetto.
+inline void write_trace_json(const std::string &path,
+                             std::chrono::steady_clock::time_point origin,
+                             const std::vector<SearchStats> &stats) {
+  std::ofstream out(path);
+  auto us = [origin](std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration<double, std::micro>(t - origin).count();
+  };
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  for (int tid = 0; tid < stats.size(); ++tid) {
+    out << std::format("{}{{\"name\": \"thread_name\", \"ph\": \"M\", "
+                       "\"pid\": 0, \"tid\": {}, \"args\": {{\"name\": "
+                       "\"worker {}\"}}}}",
+                       tid ? ",\n" : "\n", tid, tid);
+    for (const auto &span : stats[tid].trace) {
+      std::string sizes;
+      for (int size : span.size_sequence) {
+        sizes += std::format("{}{}", sizes.empty() ? "" : " ", size);
+      }
+      out << std::format(",\n{{\"name\": \"{}\", \"cat\": \"{}\", "
+                         "\"ph\": \"X\", \"pid\": 0, \"tid\": {}, "
+                         "\"ts\": {:.3f}, \"dur\": {:.3f}, \"args\": "
+                         "{{\"failed\": {}",
+                         sizes, span.kind, tid, us(span.start),
+                         us(span.end) - us(span.start), span.failed);
+      for (int i = 0; i < kCounterCount; ++i) {
+        if (span.counters[i] != 0 && i != kTestNs) {
+          out << std::format(", \"{}\": {}", counter_names[i],
+                             span.counters[i]);
+        }
+      }
+      out << "}}";
+    }
+  }
+  out << "\n]}\n";
+}
@@ -0,0 +1,144 @@
+// Size sequences, the non-increasing colour sizes that the searches of
+// perebor, 2_partite and 3_partite range over, and their order.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <ranges>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The size sequences of s colours in the combinatorial number system: rank r
+// is the r-th sequence ordered by the smallest size, then the next smallest
+// and so on. A rank decodes in O(s * max_size) without materialising the
+// others, so the search hands out work as ranges of ranks.
+struct SizeSequenceRanking {
+  int s;
+  int max_size;
+  // tails[k][a]: the number of sequences of k sizes, all of them at least a.
+  std::vector<std::vector<uint64_t>> tails;
+
+  SizeSequenceRanking(int s, int max_size)
+      : s(s), max_size(max_size),
+        tails(s + 1, std::vector<uint64_t>(max_size + 2)) {
+    std::ranges::fill(tails[0], 1);
+    for (int k = 1; k <= s; ++k) {
+      for (int a = max_size; a >= 1; --a) {
+        tails[k][a] = tails[k][a + 1] + tails[k - 1][a];
+      }
+    }
+  }
+
+  uint64_t size() const { return tails[s][1]; }
+
+  std::vector<int> unrank(uint64_t rank) const {
+    std::vector<int> seq(s);
+    int size = 1;
+    for (int i = s - 1; i >= 0; --i) {
+      while (rank >= tails[i][size]) {
+        rank -= tails[i][size++];
+      }
+      seq[i] = size;
+    }
+    return seq;
+  }
+
+  uint64_t rank(const std::vector<int> &seq) const {
+    uint64_t res = 0;
+    int size = 1;
+    for (int i = s - 1; i >= 0; --i) {
+      for (; size < seq[i]; ++size) {
+        res += tails[i][size];
+      }
+    }
+    return res;
+  }
+};
+
+inline bool is_better(const std::vector<int> &lhs,
+                      const std::vector<int> &rhs) {
+  for (int i = 0; i < lhs.size(); ++i) {
+    if (lhs[i] < rhs[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The size sequences obtained from `seq` by growing one colour by a single
+// edge, i.e. its immediate successors among non-increasing sequences.
+inline std::vector<std::vector<int>>
+minimal_increments(const std::vector<int> &seq, int max_size) {
+  std::vector<std::vector<int>> res;
+  for (int i = 0; i < seq.size(); ++i) {
+    if (seq[i] < max_size && (i == 0 || seq[i - 1] > seq[i])) {
+      res.push_back(seq);
+      ++res.back()[i];
+    }
+  }
+  return res;
+}
+
+// The minimal size sequences outside the down-set of `rows`: those no row
+// dominates although every one-step decrement of them is dominated. Built a
+// row at a time; a minimal sequence the new row dominates gives way to its
+// joins with the least sequences that exceed the row in one size.
+inline std::vector<std::vector<int>>
+minimal_non_members(const std::vector<std::vector<int>> &rows, int s,
+                    int max_size) {
+  std::vector<std::vector<int>> res = {std::vector<int>(s, 1)};
+  for (const auto &row : rows) {
+    std::vector<std::vector<int>> grown;
+    std::erase_if(res, [&](const std::vector<int> &seq) {
+      if (!is_better(row, seq)) {
+        return false;
+      }
+      for (int i = 0; i < s; ++i) {
+        if (row[i] == max_size) {
+          continue;
+        }
+        auto &next = grown.emplace_back(seq);
+        for (int j = 0; j <= i; ++j) {
+          next[j] = std::max(next[j], row[i] + 1);
+        }
+      }
+      return true;
+    });
+    std::ranges::sort(grown);
+    grown.erase(std::ranges::unique(grown).begin(), grown.end());
+    // A grown sequence is minimal unless it dominates another one; none is
+    // below a kept one, which was minimal outside the smaller down-set.
+    size_t kept = res.size();
+    for (const auto &seq : grown) {
+      auto below = [&](const std::vector<int> &other) {
+        return other != seq && is_better(seq, other);
+      };
+      if (std::ranges::none_of(res | std::views::take(kept), below) &&
+          std::ranges::none_of(grown, below)) {
+        res.push_back(seq);
+      }
+    }
+  }
+  std::ranges::sort(res);
+  return res;
+}
+
+inline std::vector<std::vector<int>> read_size_sequences(std::istream &in) {
+  std::vector<std::vector<int>> res;
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream ss(line);
+    std::vector<int> current;
+    int n;
+    while (ss >> n) {
+      current.push_back(n);
+    }
+    if (!current.empty()) {
+      res.push_back(std::move(current));
+    }
+  }
+  return res;
+}
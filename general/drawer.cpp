@@ -4,18 +4,30 @@
 #include <generator>
 #include <iostream>
 #include <iterator>
+#include <limits>
+#include <memory>
 #include <numeric>
+#include <optional>
 #include <set>
 #include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "../common/certificate_cache.h"
+
 using namespace std;
 
 struct MatchingState {
   vector<char> used;
   vector<pair<int, int>> matching;
+  uint64_t nodes = 0;
+  // gen_matching gives up (returns false) once nodes exceeds this.
+  uint64_t node_limit = numeric_limits<uint64_t>::max();
 
   explicit MatchingState(int s) : used(2 * s + 1) {}
 
@@ -40,6 +52,15 @@ struct ShiftedGraph {
     }
   }
 
+  bool has_edge(int x, int y) const {
+    for (auto [x0, y0] : antipath) {
+      if (x <= x0) {
+        return 1 <= y && y < x && y <= y0;
+      }
+    }
+    return false;
+  }
+
   int edge_count() const {
     int x = 1;
     int res = 0;
@@ -84,6 +105,9 @@ generator<ShiftedGraph &&> gen_graphs(int s, int current_x, int max_y) {
 
 bool gen_matching(input_iterator auto graphs_begin,
                   input_iterator auto graphs_end, MatchingState &state) {
+  if (++state.nodes > state.node_limit) {
+    return false;
+  }
   if (graphs_begin == graphs_end) {
     return true;
   }
@@ -103,6 +127,9 @@ bool gen_matching(input_iterator auto graphs_begin,
         if (gen_matching(graphs_begin, graphs_end, state)) {
           return true;
         }
+        if (state.nodes > state.node_limit) {
+          return false;
+        }
         state.matching.pop_back();
         state.used[x] = false;
         state.used[y] = false;
@@ -126,7 +153,9 @@ generator<vector<int> &&> gen_size_sequence(int s, int leftover, int min_size) {
   }
 }
 
-generator<vector<reference_wrapper<const ShiftedGraph>>>
+using GraphSequence = vector<reference_wrapper<const ShiftedGraph>>;
+
+generator<GraphSequence>
 gen_graph_sequences(input_iterator auto size_begin,
                     input_iterator auto size_end,
                     const vector<vector<ShiftedGraph>> &graphs_by_size) {
@@ -145,6 +174,59 @@ gen_graph_sequences(input_iterator auto size_begin,
   }
 }
 
+// Whether `matching` takes one edge from each graph, pairwise disjoint.
+bool is_matching(const GraphSequence &graph_sequence,
+                 const vector<pair<int, int>> &matching) {
+  vector<char> used(2 * graph_sequence.front().get().s + 1);
+  for (const auto &[graph, edge] : views::zip(graph_sequence, matching)) {
+    auto [x, y] = edge;
+    if (!graph.get().has_edge(x, y) || used[x] || used[y]) {
+      return false;
+    }
+    used[x] = used[y] = true;
+  }
+  return true;
+}
+
+// The family of the certificate cache, the same as in the search.
+constexpr string_view kCacheFamily = "general";
+
+// gen_matching behind the certificate cache. The cache is only consulted for
+// graph sequences the DFS does not decide within cache->min_nodes nodes,
+// cheaper ones are faster to recompute than to look up. On success
+// state.matching holds one edge per colour in graph_sequence order.
+bool cached_matching(const GraphSequence &graph_sequence, MatchingState &state,
+                     CertificateCache *cache) {
+  state.reset();
+  if (cache == nullptr) {
+    return gen_matching(graph_sequence.begin(), graph_sequence.end(), state);
+  }
+  state.node_limit = state.nodes + cache->min_nodes;
+  bool matchable =
+      gen_matching(graph_sequence.begin(), graph_sequence.end(), state);
+  bool decided = state.nodes <= state.node_limit;
+  state.node_limit = numeric_limits<uint64_t>::max();
+  if (decided) {
+    return matchable;
+  }
+  vector<int> order;
+  auto antipaths = views::transform(
+      graph_sequence, [](const ShiftedGraph &graph) { return graph.antipath; });
+  string key = canonical_key(graph_sequence.front().get().s, antipaths, order);
+  state.reset();
+  auto known = cache->lookup_matching(
+      key, order, state.matching, [&](const vector<pair<int, int>> &matching) {
+        return is_matching(graph_sequence, matching);
+      });
+  if (known) {
+    return *known;
+  }
+  state.reset();
+  matchable = gen_matching(graph_sequence.begin(), graph_sequence.end(), state);
+  cache->insert_matching(key, order, matchable, state.matching);
+  return matchable;
+}
+
 void print_graph_sequence(
     const vector<reference_wrapper<const ShiftedGraph>> &graph_sequence,
     vector<pair<int, int>> matching = {}) {
@@ -199,7 +281,8 @@ bool check_embedded(
 }
 
 void draw_graph(std::vector<int> size_sequence,
-                const vector<vector<ShiftedGraph>> &graphs_by_size) {
+                const vector<vector<ShiftedGraph>> &graphs_by_size,
+                CertificateCache *cache) {
   cout << "sequence {";
   for (auto it = size_sequence.begin(); next(it) != size_sequence.end(); ++it) {
     cout << *it << ',';
@@ -220,8 +303,7 @@ void draw_graph(std::vector<int> size_sequence,
           subsequence.push_back(graph_sequence[j]);
         }
       }
-      matching.reset();
-      if (!gen_matching(subsequence.begin(), subsequence.end(), matching)) {
+      if (!cached_matching(subsequence, matching, cache)) {
         ok = false;
         break;
       }
@@ -233,8 +315,7 @@ void draw_graph(std::vector<int> size_sequence,
     if (!ok) {
       continue;
     }
-    matching.reset();
-    if (!gen_matching(graph_sequence.begin(), graph_sequence.end(), matching)) {
+    if (!cached_matching(graph_sequence, matching, cache)) {
       if (!check_embedded(graph_sequence)) {
         cerr << "###############################" << endl;
         cerr << "NOT EMBEDDED" << endl;
@@ -248,7 +329,21 @@ void draw_graph(std::vector<int> size_sequence,
   }
 }
 
-int main() {
+// Usage: drawer [--cache FILE] < results/<s>max.txt
+// The cache file is shared with the search, see --cache there.
+int main(int argc, const char *argv[]) {
+  unique_ptr<CertificateCache> cache;
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (string(argv[i]) == "--cache") {
+      try {
+        cache = make_unique<CertificateCache>(argv[i + 1], kCacheFamily);
+      } catch (const runtime_error &error) {
+        cerr << error.what() << "\n";
+        return 1;
+      }
+      ++i;
+    }
+  }
   int s;
   {
     string tmp;
@@ -274,7 +369,7 @@ int main() {
       cerr << x << " ";
     }
     cerr << endl;
-    draw_graph(current, graphs_by_size);
+    draw_graph(current, graphs_by_size, cache.get());
     cout << "-------------------------" << endl;
   }
 }